@@ -0,0 +1,37 @@
+#include <pebble.h>
+#pragma once
+
+// Integer helpers for the angle and ratio math on the dial. Aplite,
+// basalt and diorite have no FPU, so any float or double here would
+// link in the soft-float routines. The wscript fails the build if they
+// show up.
+
+//////////////////////
+// fixed-point math //
+//////////////////////
+// trig angle for part out of whole, clamped to a full turn
+static inline int32_t fixed_ratio_to_trigangle(int32_t part, int32_t whole) {
+  if(whole <= 0 || part <= 0) {
+    return 0;
+  }
+  if(part >= whole) {
+    return TRIG_MAX_ANGLE;
+  }
+  return (int32_t)(((int64_t)part * TRIG_MAX_ANGLE) / whole);
+}
+
+// trig angle for percent 0..100
+static inline int32_t fixed_percent_to_trigangle(int percent) {
+  return fixed_ratio_to_trigangle(percent, 100);
+}
+
+// length scaled by a sin_lookup/cos_lookup result
+static inline int32_t fixed_trig_scale(int32_t trig, int32_t length) {
+  return (trig * length) / TRIG_MAX_RATIO;
+}
+
+// point at distance from center along a trig angle, 0 is 12 o'clock
+static inline GPoint fixed_polar_point(GPoint center, int32_t angle, int32_t length) {
+  return GPoint(center.x + fixed_trig_scale(sin_lookup(angle), length),
+                center.y + fixed_trig_scale(-cos_lookup(angle), length));
+}
@@ -0,0 +1,176 @@
+// Keeps today's step count for the step ring. Movement updates are
+// throttled to one query per HEALTH_QUERY_MS, the count is kept as an
+// integer, and the watchface is only told to redraw when the label or
+// the quantized ring angle actually changes. The goal is the typical
+// step count for this kind of day when the watch knows one.
+
+
+#include <pebble.h>
+#include "fixed.h"
+#include "health.h"
+#include "perf.h"
+
+
+static HealthChangedHandler s_handler;
+#if defined(PBL_HEALTH)
+static AppTimer *s_throttle;
+static bool s_pending;
+#endif
+static int32_t s_steps, s_goal = HEALTH_DEFAULT_GOAL;
+static char s_label[12]; // any int, "k" or not
+static int s_ring_angle;
+
+
+////////////////////////////////////////
+// typical steps for a day like today //
+////////////////////////////////////////
+static void health_load_goal() {
+  s_goal = HEALTH_DEFAULT_GOAL;
+#if defined(PBL_HEALTH)
+  time_t start = time_start_of_today();
+  time_t end = start + SECONDS_PER_DAY;
+  if(health_service_metric_averaged_accessible(HealthMetricStepCount, start, end, HealthServiceTimeScopeDailyWeekdayOrWeekend) &
+     HealthServiceAccessibilityMaskAvailable) {
+    HealthValue average = health_service_sum_averaged(HealthMetricStepCount, start, end, HealthServiceTimeScopeDailyWeekdayOrWeekend);
+    if(average > 0) {
+      s_goal = average;
+    }
+  }
+#endif
+}
+
+
+///////////////////////////////////
+// read steps and report changes //
+///////////////////////////////////
+static void health_query() {
+#if defined(PBL_HEALTH)
+  s_steps = health_service_sum_today(HealthMetricStepCount);
+#endif
+  
+  char label[sizeof(s_label)];
+  if(s_steps >= 1000) {
+    snprintf(label, sizeof(label), "%dk", (int)(s_steps / 1000));
+  } else {
+    snprintf(label, sizeof(label), "%d", (int)s_steps);
+  }
+  
+  int angle = fixed_ratio_to_trigangle(s_steps, s_goal) * 360 / TRIG_MAX_ANGLE;
+  angle -= angle % HEALTH_RING_QUANTUM;
+  
+  bool label_changed = strcmp(label, s_label) != 0;
+  bool ring_changed = angle != s_ring_angle;
+  if(label_changed) {
+    strcpy(s_label, label);
+  }
+  s_ring_angle = angle;
+  
+  if((label_changed || ring_changed) && s_handler) {
+    s_handler(label_changed, ring_changed);
+  }
+}
+
+
+#if defined(PBL_HEALTH)
+////////////////////////////////////
+// throttle window over, catch up //
+////////////////////////////////////
+static void health_throttle_done(void *data) {
+  PERF_SCOPE(PERF_HEALTH_TIMER);
+  s_throttle = NULL;
+  if(s_pending) {
+    s_pending = false;
+    health_query();
+    s_throttle = app_timer_register(HEALTH_QUERY_MS, health_throttle_done, NULL);
+  }
+}
+
+
+///////////////////////////////
+// query now or after window //
+///////////////////////////////
+static void health_request(bool now) {
+  if(s_throttle && !now) {
+    s_pending = true;
+    return;
+  }
+  
+  s_pending = false;
+  health_query();
+  if(s_throttle) {
+    app_timer_reschedule(s_throttle, HEALTH_QUERY_MS);
+  } else {
+    s_throttle = app_timer_register(HEALTH_QUERY_MS, health_throttle_done, NULL);
+  }
+}
+
+
+///////////////////////////
+// health service events //
+///////////////////////////
+static void health_event(HealthEventType event, void *context) {
+  PERF_SCOPE(PERF_HEALTH_EVENT);
+  switch(event) {
+    case HealthEventSignificantUpdate:
+      // new day or history changed, steps may have gone back to zero
+      health_load_goal();
+      health_request(true);
+      break;
+    case HealthEventMovementUpdate:
+      health_request(false);
+      break;
+    default:
+      break;
+  }
+}
+#endif
+
+
+//////////////////////////////
+// first read and subscribe //
+//////////////////////////////
+void health_init(HealthChangedHandler handler) {
+  s_handler = handler;
+  health_load_goal();
+#if defined(PBL_HEALTH)
+  health_service_events_subscribe(health_event, NULL);
+  health_request(true);
+#else
+  // no steps to count, and no throttle, the empty ring is set once
+  health_query();
+#endif
+}
+
+
+void health_deinit() {
+#if defined(PBL_HEALTH)
+  health_service_events_unsubscribe();
+  if(s_throttle) {
+    app_timer_cancel(s_throttle);
+    s_throttle = NULL;
+  }
+#endif
+  s_handler = NULL;
+}
+
+
+/////////////////////////////////////////////////////////////////
+// midnight, in case the significant update is late or missing //
+/////////////////////////////////////////////////////////////////
+void health_day_changed() {
+#if defined(PBL_HEALTH)
+  health_load_goal();
+  health_request(true);
+#endif
+}
+
+
+const char *health_get_label() {
+  return s_label;
+}
+
+
+// degrees of the step ring, a multiple of HEALTH_RING_QUANTUM
+int health_get_ring_angle() {
+  return s_ring_angle;
+}
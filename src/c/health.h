@@ -0,0 +1,21 @@
+// Today's steps for the step ring. health_init subscribes to health
+// events and calls the handler only when the label text or the ring
+// angle changed, health_day_changed is for the midnight tick.
+
+#include <pebble.h>
+#pragma once
+
+////////////////////
+// health timings //
+////////////////////
+#define HEALTH_QUERY_MS 30000 // movement updates closer than this share one query
+#define HEALTH_RING_QUANTUM 5 // degrees, ring is only redrawn when it crosses one
+#define HEALTH_DEFAULT_GOAL 10000 // steps, when there is no daily average yet
+
+typedef void (*HealthChangedHandler)(bool label_changed, bool ring_changed);
+
+void health_init(HealthChangedHandler handler);
+void health_deinit();
+void health_day_changed();
+const char *health_get_label();
+int health_get_ring_angle();
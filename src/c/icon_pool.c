@@ -0,0 +1,206 @@
+// Keeps icon bitmaps loaded from resources so they are created once
+// and shared. Icons in use are never freed, unused ones stay cached
+// until the pool goes over ICON_POOL_BUDGET, oldest first. On color
+// platforms every icon is recolored to the pool color by rewriting its
+// palette, so one asset serves both themes.
+
+
+#include <pebble.h>
+#include "icon_pool.h"
+#include "perf.h"
+
+
+typedef struct IconPoolEntry {
+  uint32_t resource_id;
+  GBitmap *bitmap;
+  uint16_t size;
+  uint8_t users;
+  uint32_t last_used;
+} IconPoolEntry;
+
+static IconPoolEntry s_entries[ICON_POOL_SLOTS];
+static uint32_t s_clock;
+static int s_bytes;
+static GColor s_color;
+static bool s_color_set;
+
+
+//////////////////////////////////////////////
+// swap palette colors, keeping their alpha //
+//////////////////////////////////////////////
+static void icon_recolor(GBitmap *bitmap) {
+#if defined(PBL_COLOR)
+  int colors;
+  switch(gbitmap_get_format(bitmap)) {
+    case GBitmapFormat1BitPalette: colors = 2; break;
+    case GBitmapFormat2BitPalette: colors = 4; break;
+    case GBitmapFormat4BitPalette: colors = 16; break;
+    default:
+      APP_LOG(APP_LOG_LEVEL_WARNING, "icon_pool icon has no palette");
+      return;
+  }
+  
+  GColor *palette = gbitmap_get_palette(bitmap);
+  for(int i=0; i<colors; i++) {
+    uint8_t alpha = palette[i].a;
+    palette[i] = s_color;
+    palette[i].a = alpha;
+  }
+#endif
+}
+
+
+//////////////////////////
+// free a pooled bitmap //
+//////////////////////////
+static void entry_free(IconPoolEntry *entry) {
+  gbitmap_destroy(entry->bitmap);
+  s_bytes -= entry->size;
+  *entry = (IconPoolEntry) { 0 };
+}
+
+
+////////////////////////////////////
+// least recently used idle entry //
+////////////////////////////////////
+static IconPoolEntry *entry_lru_idle() {
+  IconPoolEntry *lru = NULL;
+  for(int i=0; i<ICON_POOL_SLOTS; i++) {
+    IconPoolEntry *entry = &s_entries[i];
+    if(entry->bitmap && entry->users == 0 && (!lru || entry->last_used < lru->last_used)) {
+      lru = entry;
+    }
+  }
+  return lru;
+}
+
+
+/////////////////////////////////////////
+// evict idle icons until under budget //
+/////////////////////////////////////////
+static void pool_shrink(int budget) {
+  while(s_bytes > budget) {
+    IconPoolEntry *lru = entry_lru_idle();
+    if(!lru) {
+      return;
+    }
+    entry_free(lru);
+  }
+}
+
+
+////////////////////////////////////////////////
+// decode one resource, timed in stats builds //
+////////////////////////////////////////////////
+static GBitmap *icon_decode(uint32_t resource_id) {
+  PERF_SCOPE(PERF_ICON_DECODE);
+  return gbitmap_create_with_resource(resource_id);
+}
+
+
+///////////////////////////////////////
+// get icon, loading it if necessary //
+///////////////////////////////////////
+GBitmap *icon_pool_acquire(uint32_t resource_id) {
+  IconPoolEntry *slot = NULL;
+  
+  for(int i=0; i<ICON_POOL_SLOTS; i++) {
+    IconPoolEntry *entry = &s_entries[i];
+    if(entry->bitmap && entry->resource_id == resource_id) {
+      entry->users++;
+      entry->last_used = ++s_clock;
+      return entry->bitmap;
+    }
+    if(!entry->bitmap && !slot) {
+      slot = entry;
+    }
+  }
+  
+  // all slots taken, reuse the oldest idle one
+  if(!slot) {
+    slot = entry_lru_idle();
+    if(!slot) {
+      APP_LOG(APP_LOG_LEVEL_ERROR, "icon_pool full");
+      return NULL;
+    }
+    entry_free(slot);
+  }
+  
+  GBitmap *bitmap = icon_decode(resource_id);
+  if(!bitmap) {
+    // heap is short, drop every idle icon and try once more
+    pool_shrink(0);
+    bitmap = icon_decode(resource_id);
+    if(!bitmap) {
+      APP_LOG(APP_LOG_LEVEL_ERROR, "icon_pool out of memory");
+      return NULL;
+    }
+  }
+  
+  if(s_color_set) {
+    icon_recolor(bitmap);
+  }
+  
+  GRect bounds = gbitmap_get_bounds(bitmap);
+  slot->resource_id = resource_id;
+  slot->bitmap = bitmap;
+  slot->size = gbitmap_get_bytes_per_row(bitmap) * bounds.size.h;
+  slot->users = 1;
+  slot->last_used = ++s_clock;
+  s_bytes += slot->size;
+  
+  pool_shrink(ICON_POOL_BUDGET);
+  
+  return bitmap;
+}
+
+
+////////////////////////////////////
+// icon no longer shown by caller //
+////////////////////////////////////
+void icon_pool_release(GBitmap *bitmap) {
+  if(!bitmap) {
+    return;
+  }
+  for(int i=0; i<ICON_POOL_SLOTS; i++) {
+    IconPoolEntry *entry = &s_entries[i];
+    if(entry->bitmap == bitmap) {
+      if(entry->users > 0) {
+        entry->users--;
+      }
+      pool_shrink(ICON_POOL_BUDGET);
+      return;
+    }
+  }
+}
+
+
+//////////////////////////////////////////
+// recolor loaded icons and future ones //
+//////////////////////////////////////////
+void icon_pool_set_color(GColor color) {
+  if(s_color_set && gcolor_equal(color, s_color)) {
+    return;
+  }
+  s_color = color;
+  s_color_set = true;
+  
+  for(int i=0; i<ICON_POOL_SLOTS; i++) {
+    if(s_entries[i].bitmap) {
+      icon_recolor(s_entries[i].bitmap);
+    }
+  }
+}
+
+
+/////////////////////
+// free every icon //
+/////////////////////
+void icon_pool_destroy() {
+  for(int i=0; i<ICON_POOL_SLOTS; i++) {
+    if(s_entries[i].bitmap) {
+      entry_free(&s_entries[i]);
+    }
+  }
+  s_clock = 0;
+}
@@ -0,0 +1,17 @@
+// Shared icon bitmaps. Every icon_pool_acquire needs a matching
+// icon_pool_release, the pool decides when the bitmap is really freed.
+// icon_pool_set_color recolors every icon, loaded or not, to one color.
+
+#include <pebble.h>
+#pragma once
+
+////////////////////////
+// icon pool settings //
+////////////////////////
+#define ICON_POOL_SLOTS 8
+#define ICON_POOL_BUDGET 2048 // bytes of bitmap data kept around once unused
+
+GBitmap *icon_pool_acquire(uint32_t resource_id);
+void icon_pool_release(GBitmap *bitmap);
+void icon_pool_set_color(GColor color);
+void icon_pool_destroy();
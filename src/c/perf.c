@@ -0,0 +1,185 @@
+// Debug instrumentation, only built with PERF_STATS. Update procs and
+// handlers open a PERF_SCOPE that adds a call count and time_ms elapsed
+// time to their probe and a sample to a ring of the most recent calls.
+// Each sample also checks the heap, so the dump has a high-water mark.
+// perf_dump sends it all as text to the phone log. Watchfaces get no
+// buttons, so a flick of the wrist asks for it.
+
+
+#include <pebble.h>
+#include "perf.h"
+
+#if PERF_STATS
+
+typedef struct PerfTotal {
+  uint32_t calls;
+  uint32_t ms;
+  uint16_t max_ms;
+} PerfTotal;
+
+typedef struct PerfSample {
+  uint8_t probe;
+  uint16_t ms;
+} PerfSample;
+
+static const char *const s_names[PERF_PROBE_COUNT] = {
+  [PERF_DIAL_PROC] = "dial",
+  [PERF_TEMP_PROC] = "temp",
+  [PERF_BATTERY_PROC] = "battery",
+  [PERF_HEALTH_PROC] = "health",
+  [PERF_TICKS_PROC] = "ticks",
+  [PERF_COMPOSITOR_PROC] = "compositor",
+  [PERF_TICK_HANDLER] = "tick_handler",
+  [PERF_BATTERY_HANDLER] = "battery_handler",
+  [PERF_BLUETOOTH_CALLBACK] = "bluetooth",
+  [PERF_HEALTH_EVENT] = "health_event",
+  [PERF_HEALTH_TIMER] = "health_timer",
+  [PERF_WEATHER_TIMER] = "weather_timer",
+  [PERF_INBOX] = "inbox",
+  [PERF_ICON_DECODE] = "icon_decode",
+};
+
+static PerfTotal s_totals[PERF_PROBE_COUNT];
+static PerfSample s_ring[PERF_RING_SIZE];
+static uint32_t s_ring_count; // samples ever added, next goes at count % size
+static size_t s_heap_high, s_heap_free_low = SIZE_MAX;
+#if PERF_OVERLAY
+static uint32_t s_overlay_frames;
+#endif
+
+
+//////////////////////////////////
+// flick of the wrist, dump now //
+//////////////////////////////////
+static void perf_tap_handler(AccelAxisType axis, int32_t direction) {
+  perf_dump();
+}
+
+
+/////////////////////////////////
+// taps send the dump from now //
+/////////////////////////////////
+void perf_init() {
+  accel_tap_service_subscribe(perf_tap_handler);
+}
+
+
+void perf_deinit() {
+  accel_tap_service_unsubscribe();
+}
+
+
+////////////////////////////
+// start timing one probe //
+////////////////////////////
+PerfScope perf_scope_begin(PerfProbe probe) {
+  PerfScope scope = { .probe = probe };
+  time_ms(&scope.start_s, &scope.start_ms);
+  return scope;
+}
+
+
+///////////////////////////////////////////////
+// scope left, add it to totals and the ring //
+///////////////////////////////////////////////
+void perf_scope_end(PerfScope *scope) {
+  time_t end_s;
+  uint16_t end_ms;
+  time_ms(&end_s, &end_ms);
+  uint32_t ms = ((end_s - scope->start_s) * 1000) + end_ms - scope->start_ms;
+
+  PerfTotal *total = &s_totals[scope->probe];
+  total->calls++;
+  total->ms += ms;
+  total->max_ms = MAX(total->max_ms, MIN(ms, UINT16_MAX));
+
+  s_ring[s_ring_count % PERF_RING_SIZE] = (PerfSample) { .probe = scope->probe, .ms = MIN(ms, UINT16_MAX) };
+  s_ring_count++;
+
+  s_heap_high = MAX(s_heap_high, heap_bytes_used());
+  s_heap_free_low = MIN(s_heap_free_low, heap_bytes_free());
+}
+
+
+#if PERF_OVERLAY
+///////////////////////////////////////////////
+// update proc time per frame, in 1/10 of ms //
+///////////////////////////////////////////////
+static uint32_t perf_frame_tenths() {
+  // the compositor already includes the procs it calls
+  uint32_t ms = s_totals[PERF_COMPOSITOR_PROC].ms;
+  if(s_totals[PERF_COMPOSITOR_PROC].calls == 0) {
+    for(int i=PERF_DIAL_PROC; i<=PERF_TICKS_PROC; i++) {
+      ms += s_totals[i].ms;
+    }
+  }
+  return s_overlay_frames ? (ms * 10) / s_overlay_frames : 0;
+}
+
+
+/////////////////////////////////////
+// stats on top of everything else //
+/////////////////////////////////////
+static void perf_overlay_update_proc(Layer *layer, GContext *ctx) {
+  // drawn every frame, so it also counts them
+  s_overlay_frames++;
+
+  static char text[48];
+  uint32_t tenths = perf_frame_tenths();
+  snprintf(text, sizeof(text), "%d fr %d.%dms\nheap %d/%d", (int)s_overlay_frames, (int)(tenths / 10),
+           (int)(tenths % 10), (int)s_heap_high, (int)(s_heap_high + s_heap_free_low));
+
+  // opaque, partial redraw leaves the previous frame underneath
+  GRect bounds = layer_get_bounds(layer);
+  graphics_context_set_fill_color(ctx, GColorBlack);
+  graphics_fill_rect(ctx, bounds, 0, GCornerNone);
+  graphics_context_set_text_color(ctx, GColorWhite);
+  graphics_draw_text(ctx, text, fonts_get_system_font(FONT_KEY_GOTHIC_14), bounds, GTextOverflowModeWordWrap,
+                     GTextAlignmentCenter, NULL);
+}
+
+
+////////////////////////////////////////
+// layer for the overlay, add it last //
+////////////////////////////////////////
+Layer *perf_overlay_create(GRect frame) {
+  Layer *layer = layer_create(frame);
+  layer_set_update_proc(layer, perf_overlay_update_proc);
+  return layer;
+}
+#endif
+
+
+/////////////////////////////////////
+// send the stats to the phone log //
+/////////////////////////////////////
+void perf_dump() {
+  static char text[PERF_DUMP_SIZE];
+  int length = snprintf(text, sizeof(text), "heap high %d free low %d\n", (int)s_heap_high, (int)s_heap_free_low);
+
+  for(int i=0; i<PERF_PROBE_COUNT && length < (int)sizeof(text); i++) {
+    if(s_totals[i].calls) {
+      length += snprintf(text + length, sizeof(text) - length, "%s %d calls %d ms max %d\n", s_names[i],
+                         (int)s_totals[i].calls, (int)s_totals[i].ms, (int)s_totals[i].max_ms);
+    }
+  }
+
+  // most recent calls, oldest first
+  uint32_t first = s_ring_count > PERF_RING_SIZE ? s_ring_count - PERF_RING_SIZE : 0;
+  for(uint32_t i=first; i<s_ring_count && length < (int)sizeof(text); i++) {
+    const PerfSample *sample = &s_ring[i % PERF_RING_SIZE];
+    length += snprintf(text + length, sizeof(text) - length, "%s:%d ", s_names[sample->probe], (int)sample->ms);
+  }
+
+  DictionaryIterator *iter;
+  AppMessageResult result = app_message_outbox_begin(&iter);
+  if(result == APP_MSG_OK) {
+    dict_write_cstring(iter, MESSAGE_KEY_KEY_PERF_STATS, text);
+    result = app_message_outbox_send();
+  }
+  if(result != APP_MSG_OK) {
+    APP_LOG(APP_LOG_LEVEL_WARNING, "perf_dump not sent: %d", (int)result);
+  }
+}
+
+#endif
@@ -0,0 +1,65 @@
+// Debug timing and heap stats, see perf.c. Build flags live here and
+// every call site goes through PERF_SCOPE or an #if PERF_STATS, so the
+// release build has none of it. A tap on the watch sends the dump.
+
+#include <pebble.h>
+#pragma once
+
+/////////////////////
+// instrumentation //
+/////////////////////
+// time update procs and handlers and track the heap, 0 compiles every
+// PERF_ call out so release builds carry none of it
+#ifndef PERF_STATS
+#define PERF_STATS 0
+#endif
+
+// with PERF_STATS, draw the stats at the bottom of the face, ignored
+// without it
+#ifndef PERF_OVERLAY
+#define PERF_OVERLAY 0
+#endif
+
+#define PERF_RING_SIZE 32 // most recent calls kept for a dump
+#define PERF_DUMP_SIZE 640 // text sent to the phone log, one message
+
+typedef enum PerfProbe {
+  PERF_DIAL_PROC,
+  PERF_TEMP_PROC,
+  PERF_BATTERY_PROC,
+  PERF_HEALTH_PROC,
+  PERF_TICKS_PROC,
+  PERF_COMPOSITOR_PROC,
+  PERF_TICK_HANDLER,
+  PERF_BATTERY_HANDLER,
+  PERF_BLUETOOTH_CALLBACK,
+  PERF_HEALTH_EVENT,
+  PERF_HEALTH_TIMER,
+  PERF_WEATHER_TIMER,
+  PERF_INBOX,
+  PERF_ICON_DECODE,
+  PERF_PROBE_COUNT
+} PerfProbe;
+
+#if PERF_STATS
+typedef struct PerfScope {
+  PerfProbe probe;
+  time_t start_s;
+  uint16_t start_ms;
+} PerfScope;
+
+// time from here to the end of the enclosing block, early returns included
+#define PERF_SCOPE(probe) \
+  PerfScope perf_scope __attribute__((cleanup(perf_scope_end))) = perf_scope_begin(probe)
+
+void perf_init();
+void perf_deinit();
+PerfScope perf_scope_begin(PerfProbe probe);
+void perf_scope_end(PerfScope *scope);
+void perf_dump();
+#if PERF_OVERLAY
+Layer *perf_overlay_create(GRect frame);
+#endif
+#else
+#define PERF_SCOPE(probe)
+#endif
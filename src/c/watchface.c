@@ -31,19 +31,69 @@
 
 #include <pebble.h>
 #include "watchface.h"
+#include "health.h"
+#include "fixed.h"
+#include "icon_pool.h"
+#include "perf.h"
+#include "weather_conditions.h"
+#include "weather_scheduler.h"
 
 
 static Window *s_main_window;
-static Layer *s_dial_layer, *s_hands_layer, *s_temp_circle, *s_battery_circle, *s_health_circle;
+static Layer *s_dial_layer, *s_hands_layer, *s_battery_circle, *s_health_circle;
+#if !SINGLE_LAYER
+static Layer *s_temp_circle;
+#endif
+#if PERF_STATS && PERF_OVERLAY
+static Layer *s_perf_layer;
+#endif
 static TextLayer *s_temp_layer, *s_health_layer, *s_day_text_layer, *s_date_text_layer;
 static GBitmap *s_weather_bitmap, *s_health_bitmap, *s_bluetooth_bitmap, *s_charging_bitmap, *s_bluetooth_bitmap;
 static BitmapLayer *s_weather_bitmap_layer, *s_health_bitmap_layer, *s_bluetooth_bitmap_layer, *s_charging_bitmap_layer, *s_bluetooth_bitmap_layer;
-static int buf=PBL_IF_ROUND_ELSE(0, 24), battery_percent, step_goal=10000;
+static int buf=PBL_IF_ROUND_ELSE(0, 24), battery_percent;
 static GFont s_word_font, s_number_font;
-static char icon_buf[64];
-static double step_count;
-static char *char_current_steps;
+static uint8_t s_condition = WEATHER_CONDITION_UNKNOWN;
+static int s_temp_f, s_temp_c;
+static bool s_temp_valid;
+static const char *s_temp_text, *s_health_text, *s_day_text, *s_date_text;
+static bool s_bluetooth_connected = true;
+#if SINGLE_LAYER
+static uint8_t s_widget_dirty; // bit per Widget
+#endif
+static WeatherPayload s_weather;
+static time_t s_weather_received;
+static ForecastPayload s_forecast;
+static int s_forecast_slot = -1;
 static bool charging;
+static GBitmap *s_dial_cache;
+static GColor s_dial_cache_bg, s_dial_cache_fg;
+static HandSegment s_minute_hands[MINUTE_POSITIONS], s_hour_hands[HOUR_POSITIONS], s_hour_fillers[HOUR_POSITIONS];
+static GPoint s_hands_center;
+static int s_minute_slot, s_hour_slot;
+static bool s_full_redraw = true;
+static GRect s_minute_restore, s_hour_restore;
+#if PERF_STATS
+static uint32_t s_redraw_pixels; // dial area repainted since the last tick
+#endif
+
+// areas of the dial that widgets draw into, restored every frame in partial redraw mode
+// indexed by Widget
+static const GRect s_widget_rects[WIDGET_COUNT] = {
+  {{PBL_IF_ROUND_ELSE(70, 52), 16}, {41, 41}}, // temperature circle, text and icon
+  {{PBL_IF_ROUND_ELSE(16, 4), PBL_IF_ROUND_ELSE(70, 64)}, {40, 40}}, // battery, charging and bluetooth
+  {{PBL_IF_ROUND_ELSE(70, 52), PBL_IF_ROUND_ELSE(122, 110)}, {40, 40}}, // steps, text and shoe
+  {{PBL_IF_ROUND_ELSE(113, 89), PBL_IF_ROUND_ELSE(81, 75)}, {53, 17}}, // day and date box
+};
+
+// text and icon frames inside the widgets
+static const GRect s_temp_text_frame = {{PBL_IF_ROUND_ELSE(78, 60), 19}, {24, 16}};
+static const GRect s_weather_icon_frame = {{PBL_IF_ROUND_ELSE(78, 60), 35}, {24, 16}};
+static const GRect s_charging_icon_frame = {{PBL_IF_ROUND_ELSE(38, 26), PBL_IF_ROUND_ELSE(82, 76)}, {14, 14}};
+static const GRect s_bluetooth_icon_frame = {{PBL_IF_ROUND_ELSE(20, 8), PBL_IF_ROUND_ELSE(82, 76)}, {14, 14}};
+static const GRect s_health_text_frame = {{PBL_IF_ROUND_ELSE(72, 54), PBL_IF_ROUND_ELSE(127, 115)}, {36, 16}};
+static const GRect s_shoe_icon_frame = {{PBL_IF_ROUND_ELSE(78, 60), PBL_IF_ROUND_ELSE(143, 131)}, {24, 16}};
+static const GRect s_day_text_frame = {{PBL_IF_ROUND_ELSE(114, 90), PBL_IF_ROUND_ELSE(81, 75)}, {34, 14}};
+static const GRect s_date_text_frame = {{PBL_IF_ROUND_ELSE(148, 124), PBL_IF_ROUND_ELSE(81, 75)}, {17, 14}};
 
 
 static ClaySettings settings; // An instance of the struct
@@ -56,6 +106,7 @@ static void config_default() {
 	settings.BackgroundColor = GColorBlack;
   settings.ForegroundColor = GColorWhite;
   settings.InvertColors = false;
+  settings.Celsius = false;
 }
 
 
@@ -70,25 +121,55 @@ static void config_load() {
 }
 
 
+////////////////////////////////////////////////
+// how icons are drawn for the current colors //
+////////////////////////////////////////////////
+static GCompOp icon_compositing() {
+  // color icons are recolored by the pool and alpha blended, 1-bit
+  // icons are white glyphs, Or paints them white and Clear black
+  return PBL_IF_COLOR_ELSE(GCompOpSet, gcolor_equal(settings.ForegroundColor, GColorBlack) ? GCompOpClear : GCompOpOr);
+}
+
+
 ///////////////////////
 // sets watch colors //
 ///////////////////////
 static void setColors() {
   
   // set background color
-  window_set_background_color(s_main_window, settings.BackgroundColor);
+  // partial redraw relies on the window leaving the previous frame in place
+  window_set_background_color(s_main_window, PARTIAL_REDRAW ? GColorClear : settings.BackgroundColor);
+  
+  // cached dial is only valid for the colors it was drawn in
+  if(s_dial_cache && (!gcolor_equal(s_dial_cache_bg, settings.BackgroundColor) ||
+                      !gcolor_equal(s_dial_cache_fg, settings.ForegroundColor))) {
+    dial_cache_destroy();
+    layer_mark_dirty(s_dial_layer);
+  }
   
+#if SINGLE_LAYER
+  // everything is drawn again in the new colors
+  s_full_redraw = true;
+  layer_mark_dirty(s_dial_layer);
+#else
   // set text color for TextLayers
   text_layer_set_text_color(s_temp_layer, settings.ForegroundColor);
   text_layer_set_text_color(s_health_layer, settings.ForegroundColor);
   text_layer_set_text_color(s_day_text_layer, settings.ForegroundColor);
   text_layer_set_text_color(s_date_text_layer, settings.ForegroundColor);
   
+  // icons
+  bitmap_layer_set_compositing_mode(s_weather_bitmap_layer, icon_compositing());
+  bitmap_layer_set_compositing_mode(s_charging_bitmap_layer, icon_compositing());
+  bitmap_layer_set_compositing_mode(s_bluetooth_bitmap_layer, icon_compositing());
+  bitmap_layer_set_compositing_mode(s_health_bitmap_layer, icon_compositing());
+  
   // draw hands
   layer_mark_dirty(s_hands_layer); 
+#endif
   
-  // load appropriate icon
-  load_icons(); 
+  // same icons in the new color, nothing is reloaded
+  icon_pool_set_color(settings.ForegroundColor);
   
   APP_LOG(APP_LOG_LEVEL_DEBUG, "setColors");
 }
@@ -104,11 +185,121 @@ static void config_save() {
 }
 
 
+///////////////////////////////////////
+// copy frame buffer into dial cache //
+///////////////////////////////////////
+static void dial_cache_capture(GContext *ctx) {
+  GBitmap *frame_buffer = graphics_capture_frame_buffer(ctx);
+  if(!frame_buffer) {
+    return;
+  }
+  
+  GRect fb_bounds = gbitmap_get_bounds(frame_buffer);
+  s_dial_cache = gbitmap_create_blank(fb_bounds.size, PBL_IF_COLOR_ELSE(GBitmapFormat8Bit, GBitmapFormat1Bit));
+  
+  // if heap is short the dial just gets redrawn by hand next frame
+  if(s_dial_cache) {
+#if defined(PBL_COLOR)
+    // chalk frame buffer is circular, so copy only the visible span of each row
+    for(int y=0; y<fb_bounds.size.h; y++) {
+      GBitmapDataRowInfo src = gbitmap_get_data_row_info(frame_buffer, y);
+      GBitmapDataRowInfo dst = gbitmap_get_data_row_info(s_dial_cache, y);
+      memcpy(&dst.data[src.min_x], &src.data[src.min_x], src.max_x-src.min_x+1);
+    }
+#else
+    uint8_t *src = gbitmap_get_data(frame_buffer);
+    uint8_t *dst = gbitmap_get_data(s_dial_cache);
+    int src_row = gbitmap_get_bytes_per_row(frame_buffer);
+    int dst_row = gbitmap_get_bytes_per_row(s_dial_cache);
+    for(int y=0; y<fb_bounds.size.h; y++) {
+      memcpy(dst+(y*dst_row), src+(y*src_row), dst_row<src_row ? dst_row : src_row);
+    }
+#endif
+    s_dial_cache_bg = settings.BackgroundColor;
+    s_dial_cache_fg = settings.ForegroundColor;
+  }
+  
+  graphics_release_frame_buffer(ctx, frame_buffer);
+}
+
+
+#if PARTIAL_REDRAW || SINGLE_LAYER
+///////////////////////////////////////
+// copy part of dial cache to screen //
+///////////////////////////////////////
+static void dial_cache_restore(GContext *ctx, GRect rect) {
+  GRect cache_bounds = gbitmap_get_bounds(s_dial_cache);
+  grect_clip(&rect, &cache_bounds);
+  if(grect_is_empty(&rect)) {
+    return;
+  }
+  
+  gbitmap_set_bounds(s_dial_cache, rect);
+  graphics_draw_bitmap_in_rect(ctx, s_dial_cache, rect);
+  gbitmap_set_bounds(s_dial_cache, cache_bounds);
+  
+#if PERF_STATS
+  s_redraw_pixels += rect.size.w * rect.size.h;
+#endif
+}
+#endif
+
+
+////////////////////////
+// destroy dial cache //
+////////////////////////
+static void dial_cache_destroy() {
+  if(s_dial_cache) {
+    gbitmap_destroy(s_dial_cache);
+    s_dial_cache = NULL;
+  }
+}
+
+
+///////////////////////////////////////
+// whole dial was just put on screen //
+///////////////////////////////////////
+static void dial_redraw_done(GRect bounds) {
+  s_full_redraw = false;
+  s_minute_restore = GRectZero;
+  s_hour_restore = GRectZero;
+#if PERF_STATS
+  s_redraw_pixels += bounds.size.w * bounds.size.h;
+#endif
+}
+
+
 /////////////////////////
 // draws dial on watch //
 /////////////////////////
 static void dial_update_proc(Layer *layer, GContext *ctx) {
+  PERF_SCOPE(PERF_DIAL_PROC);
   GRect bounds = layer_get_bounds(layer);
+  
+  // dial only changes with colors, so blit it once it has been drawn
+  if(s_dial_cache) {
+#if PARTIAL_REDRAW
+    // only put back the dial where the hands were and under the widgets
+    if(!s_full_redraw) {
+      dial_cache_restore(ctx, s_minute_restore);
+      dial_cache_restore(ctx, s_hour_restore);
+      for(unsigned int i=0; i<ARRAY_LENGTH(s_widget_rects); i++) {
+        dial_cache_restore(ctx, s_widget_rects[i]);
+      }
+      s_minute_restore = GRectZero;
+      s_hour_restore = GRectZero;
+      return;
+    }
+#endif
+    graphics_draw_bitmap_in_rect(ctx, s_dial_cache, bounds);
+    dial_redraw_done(bounds);
+    return;
+  }
+  
+  // fill the corners too, window background may be clear
+  graphics_context_set_fill_color(ctx, settings.BackgroundColor);
+  graphics_fill_rect(ctx, bounds, 0, GCornerNone);
+  
   GPoint center = grect_center_point(&bounds); 
   
   // draw dial
@@ -140,15 +331,8 @@ static void dial_update_proc(Layer *layer, GContext *ctx) {
 
     int angle = TRIG_MAX_ANGLE * i/tick_marks_number;
 
-    GPoint tick_mark_start = {
-      .x = (int)(sin_lookup(angle) * (int)tick_length_start / TRIG_MAX_RATIO) + center.x,
-      .y = (int)(-cos_lookup(angle) * (int)tick_length_start / TRIG_MAX_RATIO) + center.y,
-    };
-    
-    GPoint tick_mark_end = {
-      .x = (int)(sin_lookup(angle) * (int)tick_length_end / TRIG_MAX_RATIO) + center.x,
-      .y = (int)(-cos_lookup(angle) * (int)tick_length_end / TRIG_MAX_RATIO) + center.y,
-    };      
+    GPoint tick_mark_start = fixed_polar_point(center, angle, tick_length_start);
+    GPoint tick_mark_end = fixed_polar_point(center, angle, tick_length_end);
     
     graphics_draw_line(ctx, tick_mark_end, tick_mark_start);  
   } // end of loop 
@@ -162,6 +346,10 @@ static void dial_update_proc(Layer *layer, GContext *ctx) {
   GPoint start_temp_line = GPoint(PBL_IF_ROUND_ELSE(147, 123), PBL_IF_ROUND_ELSE(83, 77));
   GPoint end_temp_line = GPoint(PBL_IF_ROUND_ELSE(147, 123), PBL_IF_ROUND_ELSE(97, 91));
   graphics_draw_line(ctx, start_temp_line, end_temp_line);    
+  
+  // keep a copy for the next frame
+  dial_cache_capture(ctx);
+  dial_redraw_done(bounds);
 }
 
 
@@ -169,6 +357,7 @@ static void dial_update_proc(Layer *layer, GContext *ctx) {
 // draw temperature circle //
 /////////////////////////////
 static void temp_update_proc(Layer *layer, GContext *ctx) {
+  PERF_SCOPE(PERF_TEMP_PROC);
   graphics_context_set_stroke_color(ctx, settings.ForegroundColor);
   GPoint center = GPoint(PBL_IF_ROUND_ELSE(180/2, 144/2), 36);
   graphics_context_set_fill_color(ctx, settings.ForegroundColor);
@@ -181,9 +370,10 @@ static void temp_update_proc(Layer *layer, GContext *ctx) {
 // update battery status //
 ///////////////////////////
 static void battery_update_proc(Layer *layer, GContext *ctx) {
+  PERF_SCOPE(PERF_BATTERY_PROC);
   GRect bounds = GRect(PBL_IF_ROUND_ELSE(16, 4), PBL_IF_ROUND_ELSE(70, 64), 40, 40);
   graphics_context_set_fill_color(ctx, settings.ForegroundColor);
-  graphics_fill_radial(ctx, bounds, GOvalScaleModeFitCircle, 2, DEG_TO_TRIGANGLE(360-(battery_percent*3.6)), DEG_TO_TRIGANGLE(360));
+  graphics_fill_radial(ctx, bounds, GOvalScaleModeFitCircle, 2, TRIG_MAX_ANGLE - fixed_percent_to_trigangle(battery_percent), TRIG_MAX_ANGLE);
   
   // draw vertical battery
   graphics_context_set_stroke_color(ctx, settings.ForegroundColor);
@@ -191,9 +381,6 @@ static void battery_update_proc(Layer *layer, GContext *ctx) {
   int batt = battery_percent/10;
   graphics_fill_rect(ctx, GRect(PBL_IF_ROUND_ELSE(35, 23), PBL_IF_ROUND_ELSE(95-batt, 89-batt), 3, batt), 1, GCornerNone);
   graphics_fill_rect(ctx, GRect(PBL_IF_ROUND_ELSE(35, 23), PBL_IF_ROUND_ELSE(82, 76), 3, 1), 0, GCornerNone);  
-  
-  // set visibility of charging icon
-  layer_set_hidden(bitmap_layer_get_layer(s_charging_bitmap_layer), !charging);
 }
 
 
@@ -201,21 +388,31 @@ static void battery_update_proc(Layer *layer, GContext *ctx) {
 // update health status //
 //////////////////////////
 static void health_update_proc(Layer *layer, GContext *ctx) {
+  PERF_SCOPE(PERF_HEALTH_PROC);
   GRect bounds = GRect(PBL_IF_ROUND_ELSE(70, 52), PBL_IF_ROUND_ELSE(122, 110), 40, 40);
   graphics_context_set_fill_color(ctx, settings.ForegroundColor);
-  graphics_fill_radial(ctx, bounds, GOvalScaleModeFitCircle, 2, DEG_TO_TRIGANGLE(0), DEG_TO_TRIGANGLE((step_count/step_goal)*360));
+  graphics_fill_radial(ctx, bounds, GOvalScaleModeFitCircle, 2, 0, fixed_ratio_to_trigangle(health_get_ring_angle(), 360));
 }
 
 
-/////////////////////////////////
-// draw hands and update ticks //
-/////////////////////////////////
-static void ticks_update_proc(Layer *layer, GContext *ctx) {
-  GRect bounds = layer_get_bounds(layer);
-  GPoint center = grect_center_point(&bounds); 
-    
-  time_t now = time(NULL);
-  struct tm *t = localtime(&now);
+////////////////////////////////////////
+// endpoints of a hand at given angle //
+////////////////////////////////////////
+static HandSegment hand_segment(int angle, int start, int end) {
+  int32_t x = sin_lookup(angle);
+  int32_t y = -cos_lookup(angle);
+  return (HandSegment) {
+    .start = { fixed_trig_scale(x, start), fixed_trig_scale(y, start) },
+    .end = { fixed_trig_scale(x, end), fixed_trig_scale(y, end) },
+  };
+}
+
+
+///////////////////////////////////////////////////
+// build hand endpoints for every position, once //
+///////////////////////////////////////////////////
+static void hand_tables_init(GRect bounds) {
+  s_hands_center = grect_center_point(&bounds);
   
   int hand_point_end = ((bounds.size.h)/2)-10;
   int hand_point_start = hand_point_end - 60;
@@ -223,37 +420,98 @@ static void ticks_update_proc(Layer *layer, GContext *ctx) {
   int filler_point_end = 40;
   int filler_point_start = filler_point_end-15;
   
-  float minute_angle = TRIG_MAX_ANGLE * t->tm_min / 60;
-  GPoint minute_hand_start = {
-    .x = (int)(sin_lookup(minute_angle) * (int)hand_point_start / TRIG_MAX_RATIO) + center.x,
-    .y = (int)(-cos_lookup(minute_angle) * (int)hand_point_start / TRIG_MAX_RATIO) + center.y,
-  };
+  for(int i=0; i<MINUTE_POSITIONS; i++) {
+    int angle = TRIG_MAX_ANGLE * i / MINUTE_POSITIONS;
+    s_minute_hands[i] = hand_segment(angle, hand_point_start, hand_point_end);
+  }
   
-  GPoint minute_hand_end = {
-    .x = (int)(sin_lookup(minute_angle) * (int)hand_point_end / TRIG_MAX_RATIO) + center.x,
-    .y = (int)(-cos_lookup(minute_angle) * (int)hand_point_end / TRIG_MAX_RATIO) + center.y,
-  };    
+  for(int i=0; i<HOUR_POSITIONS; i++) {
+    int angle = TRIG_MAX_ANGLE * i / HOUR_POSITIONS;
+    s_hour_hands[i] = hand_segment(angle, hand_point_start, hand_point_end-25);
+    s_hour_fillers[i] = hand_segment(angle, filler_point_start, filler_point_end);
+  }
+}
+
+
+//////////////////////////////////
+// area covered by a drawn hand //
+//////////////////////////////////
+static GRect hand_rect(const HandSegment *hand) {
+  // hands run from the center out to their end and are at most 8px wide
+  int x = MIN(0, hand->end.x), y = MIN(0, hand->end.y);
+  int w = MAX(0, hand->end.x) - x, h = MAX(0, hand->end.y) - y;
+  return GRect(s_hands_center.x + x - HAND_MARGIN, s_hands_center.y + y - HAND_MARGIN,
+               w + (HAND_MARGIN*2) + 1, h + (HAND_MARGIN*2) + 1);
+}
+
+
+////////////////////////////////////
+// smallest rect covering a and b //
+////////////////////////////////////
+static GRect rect_union(GRect a, GRect b) {
+  if(grect_is_empty(&a)) {
+    return b;
+  }
+  if(grect_is_empty(&b)) {
+    return a;
+  }
+  int x = MIN(a.origin.x, b.origin.x);
+  int y = MIN(a.origin.y, b.origin.y);
+  int w = MAX(a.origin.x+a.size.w, b.origin.x+b.size.w) - x;
+  int h = MAX(a.origin.y+a.size.h, b.origin.y+b.size.h) - y;
+  return GRect(x, y, w, h);
+}
+
+
+#if SINGLE_LAYER
+/////////////////////////
+// do a and b overlap? //
+/////////////////////////
+static bool rect_intersects(GRect a, GRect b) {
+  return a.origin.x < b.origin.x+b.size.w && b.origin.x < a.origin.x+a.size.w &&
+         a.origin.y < b.origin.y+b.size.h && b.origin.y < a.origin.y+a.size.h &&
+         !grect_is_empty(&a) && !grect_is_empty(&b);
+}
+#endif
+
+
+////////////////////////////////
+// pick table slots for hands //
+////////////////////////////////
+static void hands_set_time(struct tm *tick_time) {
+  // remember where the hands were so the dial can be put back there
+  s_minute_restore = rect_union(s_minute_restore, hand_rect(&s_minute_hands[s_minute_slot]));
+  s_hour_restore = rect_union(s_hour_restore, hand_rect(&s_hour_hands[s_hour_slot]));
+  
+  s_minute_slot = tick_time->tm_min;
+  s_hour_slot = ((tick_time->tm_hour % 12) * 6) + (tick_time->tm_min / 10);
+}
+
+
+/////////////////////////////////
+// draw hands and update ticks //
+/////////////////////////////////
+static void ticks_update_proc(Layer *layer, GContext *ctx) {
+  PERF_SCOPE(PERF_TICKS_PROC);
+  GPoint center = s_hands_center;
   
-  float hour_angle = TRIG_MAX_ANGLE * ((((t->tm_hour % 12) * 6) + (t->tm_min / 10))) / (12 * 6);
-  GPoint hour_hand_start = {
-    .x = (int)(sin_lookup(hour_angle) * (int)hand_point_start / TRIG_MAX_RATIO) + center.x,
-    .y = (int)(-cos_lookup(hour_angle) * (int)hand_point_start / TRIG_MAX_RATIO) + center.y,
-  };
+  const HandSegment *minute = &s_minute_hands[s_minute_slot];
+  GPoint minute_hand_start = GPoint(center.x + minute->start.x, center.y + minute->start.y);
+  GPoint minute_hand_end = GPoint(center.x + minute->end.x, center.y + minute->end.y);
   
-  GPoint hour_hand_end = {
-    .x = (int)(sin_lookup(hour_angle) * (int)(hand_point_end-25) / TRIG_MAX_RATIO) + center.x,
-    .y = (int)(-cos_lookup(hour_angle) * (int)(hand_point_end-25) / TRIG_MAX_RATIO) + center.y,
-  };   
+  const HandSegment *hour = &s_hour_hands[s_hour_slot];
+  GPoint hour_hand_start = GPoint(center.x + hour->start.x, center.y + hour->start.y);
+  GPoint hour_hand_end = GPoint(center.x + hour->end.x, center.y + hour->end.y);
   
-  GPoint filler_start = {
-    .x = (int)(sin_lookup(hour_angle) * (int)filler_point_start / TRIG_MAX_RATIO) + center.x,
-    .y = (int)(-cos_lookup(hour_angle) * (int)filler_point_start / TRIG_MAX_RATIO) + center.y,
-  };
+  const HandSegment *filler = &s_hour_fillers[s_hour_slot];
+  GPoint filler_start = GPoint(center.x + filler->start.x, center.y + filler->start.y);
+  GPoint filler_end = GPoint(center.x + filler->end.x, center.y + filler->end.y);
   
-  GPoint filler_end = {
-    .x = (int)(sin_lookup(hour_angle) * (int)filler_point_end / TRIG_MAX_RATIO) + center.x,
-    .y = (int)(-cos_lookup(hour_angle) * (int)filler_point_end / TRIG_MAX_RATIO) + center.y,
-  }; 
+#if PERF_STATS
+  GRect minute_rect = hand_rect(minute);
+  GRect hour_rect = hand_rect(hour);
+  s_redraw_pixels += (minute_rect.size.w * minute_rect.size.h) + (hour_rect.size.w * hour_rect.size.h);
+#endif
   
   // set colors
   graphics_context_set_antialiased(ctx, true);
@@ -304,6 +562,137 @@ static void ticks_update_proc(Layer *layer, GContext *ctx) {
 }
 
 
+//////////////////////////////////////////////////
+// widget changed, redraw its layer or its area //
+//////////////////////////////////////////////////
+static void widget_mark_dirty(Widget widget, Layer *layer) {
+#if SINGLE_LAYER
+  s_widget_dirty |= 1 << widget;
+  layer_mark_dirty(s_dial_layer);
+#else
+  layer_mark_dirty(layer);
+#endif
+}
+
+
+///////////////////////////////////////////
+// set widget text in either render mode //
+///////////////////////////////////////////
+static void widget_set_text(Widget widget, TextLayer *layer, const char **shown, const char *text) {
+  *shown = text;
+#if SINGLE_LAYER
+  widget_mark_dirty(widget, NULL);
+#else
+  text_layer_set_text(layer, text);
+#endif
+}
+
+
+#if SINGLE_LAYER
+/////////////////////////////////////////
+// draw text like a centered TextLayer //
+/////////////////////////////////////////
+static void text_draw(GContext *ctx, const char *text, GFont font, GRect frame) {
+  if(text) {
+    graphics_draw_text(ctx, text, font, frame, GTextOverflowModeWordWrap, GTextAlignmentCenter, NULL);
+  }
+}
+
+
+//////////////////////////////////////////////////
+// draw icon centered in frame like BitmapLayer //
+//////////////////////////////////////////////////
+static void icon_draw(GContext *ctx, GBitmap *bitmap, GRect frame) {
+  if(!bitmap) {
+    return;
+  }
+  // a rect bigger than the bitmap would tile it
+  GRect rect = gbitmap_get_bounds(bitmap);
+  grect_align(&rect, &frame, GAlignCenter, true);
+  graphics_draw_bitmap_in_rect(ctx, bitmap, rect);
+}
+
+
+///////////////////////////////////
+// draw one widget over the dial //
+///////////////////////////////////
+static void widget_draw(GContext *ctx, Widget widget) {
+  graphics_context_set_text_color(ctx, settings.ForegroundColor);
+  graphics_context_set_compositing_mode(ctx, icon_compositing());
+  
+  switch(widget) {
+    case WIDGET_TEMP:
+      temp_update_proc(s_dial_layer, ctx);
+      text_draw(ctx, s_temp_text, s_number_font, s_temp_text_frame);
+      icon_draw(ctx, s_weather_bitmap, s_weather_icon_frame);
+      break;
+    case WIDGET_BATTERY:
+      battery_update_proc(s_dial_layer, ctx);
+      if(charging) {
+        icon_draw(ctx, s_charging_bitmap, s_charging_icon_frame);
+      }
+      if(!s_bluetooth_connected) {
+        icon_draw(ctx, s_bluetooth_bitmap, s_bluetooth_icon_frame);
+      }
+      break;
+    case WIDGET_HEALTH:
+      health_update_proc(s_dial_layer, ctx);
+      text_draw(ctx, s_health_text, s_number_font, s_health_text_frame);
+      icon_draw(ctx, s_health_bitmap, s_shoe_icon_frame);
+      break;
+    case WIDGET_DATE:
+      text_draw(ctx, s_day_text, s_word_font, s_day_text_frame);
+      text_draw(ctx, s_date_text, s_number_font, s_date_text_frame);
+      break;
+    default:
+      break;
+  }
+  
+  graphics_context_set_compositing_mode(ctx, GCompOpAssign);
+}
+
+
+//////////////////////////////////////////////
+// single layer mode, draw whatever changed //
+//////////////////////////////////////////////
+static void compositor_update_proc(Layer *layer, GContext *ctx) {
+  PERF_SCOPE(PERF_COMPOSITOR_PROC);
+  uint8_t dirty = s_widget_dirty;
+  s_widget_dirty = 0;
+  
+  if(!PARTIAL_REDRAW || !s_dial_cache || s_full_redraw) {
+    // whole dial, so every widget goes back on top
+    dial_update_proc(layer, ctx);
+    dirty = (1 << WIDGET_COUNT) - 1;
+  } else {
+    // put the dial back where the hands were, widgets under them need drawing again
+    dial_cache_restore(ctx, s_minute_restore);
+    dial_cache_restore(ctx, s_hour_restore);
+    for(int i=0; i<WIDGET_COUNT; i++) {
+      if(rect_intersects(s_widget_rects[i], s_minute_restore) ||
+         rect_intersects(s_widget_rects[i], s_hour_restore)) {
+        dirty |= 1 << i;
+      }
+      if(dirty & (1 << i)) {
+        dial_cache_restore(ctx, s_widget_rects[i]);
+      }
+    }
+    s_minute_restore = GRectZero;
+    s_hour_restore = GRectZero;
+  }
+  
+  for(int i=0; i<WIDGET_COUNT; i++) {
+    if(dirty & (1 << i)) {
+      widget_draw(ctx, i);
+    }
+  }
+  
+  // hands go over everything, they may cross a widget that was just drawn
+  ticks_update_proc(layer, ctx);
+}
+#endif
+
+
 //////////////////////
 // load main window //
 //////////////////////
@@ -311,10 +700,22 @@ static void main_window_load(Window *window) {
   Layer *window_layer = window_get_root_layer(window);
   GRect bounds = layer_get_bounds(window_layer);
   
-  // fonts
+  // fonts, only the glyphs in their characterRegex are installed
+#if PERF_STATS
+  size_t heap_before_fonts = heap_bytes_used();
+#endif
   s_word_font = fonts_load_custom_font(resource_get_handle(WORD_FONT));
   s_number_font = fonts_load_custom_font(resource_get_handle(NUMBER_FONT));
+#if PERF_STATS
+  APP_LOG(APP_LOG_LEVEL_INFO, "fonts use %d bytes of heap", (int)(heap_bytes_used() - heap_before_fonts));
+#endif
 
+#if SINGLE_LAYER
+  // one layer draws the dial, widgets and hands
+  s_dial_layer = layer_create(bounds);
+  layer_set_update_proc(s_dial_layer, compositor_update_proc);
+  layer_add_child(window_layer, s_dial_layer);
+#else
   // create canvas layer for dial
   s_dial_layer = layer_create(bounds);
   layer_set_update_proc(s_dial_layer, dial_update_proc);
@@ -326,33 +727,31 @@ static void main_window_load(Window *window) {
   layer_add_child(s_dial_layer, s_temp_circle);
   
   // create temp text
-  s_temp_layer = text_layer_create(GRect(PBL_IF_ROUND_ELSE(78, 60), 19, 24, 16));
+  s_temp_layer = text_layer_create(s_temp_text_frame);
   text_layer_set_background_color(s_temp_layer, GColorClear);
   text_layer_set_text_alignment(s_temp_layer, GTextAlignmentCenter);
   text_layer_set_font(s_temp_layer, s_number_font);
   layer_add_child(s_dial_layer, text_layer_get_layer(s_temp_layer));
   
+  // weather icon
+  s_weather_bitmap_layer = bitmap_layer_create(s_weather_icon_frame);
+  layer_add_child(s_dial_layer, bitmap_layer_get_layer(s_weather_bitmap_layer));
+  
   // create battery layer
   s_battery_circle = layer_create(bounds);
   layer_set_update_proc(s_battery_circle, battery_update_proc);
   layer_add_child(s_dial_layer, s_battery_circle);
   
   // charging icon
-  s_charging_bitmap = gbitmap_create_with_resource(RESOURCE_ID_LIGHTENING_WHITE_ICON);
-  s_charging_bitmap_layer = bitmap_layer_create(GRect(PBL_IF_ROUND_ELSE(38, 26), PBL_IF_ROUND_ELSE(82, 76), 14, 14));
-  bitmap_layer_set_compositing_mode(s_charging_bitmap_layer, GCompOpSet);
-  bitmap_layer_set_bitmap(s_charging_bitmap_layer, s_charging_bitmap); 
+  s_charging_bitmap_layer = bitmap_layer_create(s_charging_icon_frame);
   layer_add_child(s_dial_layer, bitmap_layer_get_layer(s_charging_bitmap_layer));    
   
   // bluetooth disconnected icon
-  s_bluetooth_bitmap = gbitmap_create_with_resource(RESOURCE_ID_BLUETOOTH_DISCONNECTED_WHITE_ICON);
-  s_bluetooth_bitmap_layer = bitmap_layer_create(GRect(PBL_IF_ROUND_ELSE(20, 8), PBL_IF_ROUND_ELSE(82, 76), 14, 14));
-  bitmap_layer_set_compositing_mode(s_bluetooth_bitmap_layer, GCompOpSet);
-  bitmap_layer_set_bitmap(s_bluetooth_bitmap_layer, s_bluetooth_bitmap); 
+  s_bluetooth_bitmap_layer = bitmap_layer_create(s_bluetooth_icon_frame);
   layer_add_child(s_dial_layer, bitmap_layer_get_layer(s_bluetooth_bitmap_layer));       
   
   // create health layer text
-  s_health_layer = text_layer_create(GRect(PBL_IF_ROUND_ELSE(72, 54), PBL_IF_ROUND_ELSE(127, 115), 36, 16));
+  s_health_layer = text_layer_create(s_health_text_frame);
   text_layer_set_background_color(s_health_layer, GColorClear);
   text_layer_set_text_alignment(s_health_layer, GTextAlignmentCenter);
   text_layer_set_font(s_health_layer, s_number_font);
@@ -364,77 +763,85 @@ static void main_window_load(Window *window) {
   layer_add_child(s_dial_layer, s_health_circle);
     
   // create shoe icon
-  s_health_bitmap = gbitmap_create_with_resource(RESOURCE_ID_SHOE_WHITE_ICON);
-  s_health_bitmap_layer = bitmap_layer_create(GRect(PBL_IF_ROUND_ELSE(78, 60), PBL_IF_ROUND_ELSE(143, 131), 24, 16));
-  bitmap_layer_set_compositing_mode(s_health_bitmap_layer, GCompOpSet);
-  bitmap_layer_set_bitmap(s_health_bitmap_layer, s_health_bitmap); 
+  s_health_bitmap_layer = bitmap_layer_create(s_shoe_icon_frame);
   layer_add_child(s_dial_layer, bitmap_layer_get_layer(s_health_bitmap_layer));
   
   // Day Text
-  s_day_text_layer = text_layer_create(GRect(PBL_IF_ROUND_ELSE(114, 90), PBL_IF_ROUND_ELSE(81, 75), 34, 14));
+  s_day_text_layer = text_layer_create(s_day_text_frame);
   text_layer_set_background_color(s_day_text_layer, GColorClear);
   text_layer_set_text_alignment(s_day_text_layer, GTextAlignmentCenter);
   text_layer_set_font(s_day_text_layer, s_word_font);
   layer_add_child(s_dial_layer, text_layer_get_layer(s_day_text_layer));
   
   // Date text
-  s_date_text_layer = text_layer_create(GRect(PBL_IF_ROUND_ELSE(148, 124), PBL_IF_ROUND_ELSE(81, 75), 17, 14));
+  s_date_text_layer = text_layer_create(s_date_text_frame);
   text_layer_set_background_color(s_date_text_layer, GColorClear);
   text_layer_set_text_alignment(s_date_text_layer, GTextAlignmentCenter);
   text_layer_set_font(s_date_text_layer, s_number_font);
-  layer_add_child(s_dial_layer, text_layer_get_layer(s_date_text_layer));  
+  layer_add_child(s_dial_layer, text_layer_get_layer(s_date_text_layer));
+#endif
   
   // create canvas layer for hands
+  hand_tables_init(bounds);
+  time_t now = time(NULL);
+  hands_set_time(localtime(&now));
+#if !SINGLE_LAYER
   s_hands_layer = layer_create(bounds);
   layer_set_update_proc(s_hands_layer, ticks_update_proc);
   layer_add_child(window_layer, s_hands_layer);
+#endif
+  
+#if PERF_STATS && PERF_OVERLAY
+  // debug stats over the bottom of the face, inside the circle on round
+  s_perf_layer = perf_overlay_create(PBL_IF_ROUND_ELSE(GRect(40, bounds.size.h - 48, bounds.size.w - 80, 34),
+                                                       GRect(0, bounds.size.h - 34, bounds.size.w, 34)));
+  layer_add_child(window_layer, s_perf_layer);
+#endif
 
+  // last reading and forecast from flash, until the phone sends something newer
+  weather_load();
+  forecast_load();
+  forecast_update(time(NULL));
+  
 	setColors();	
-	config_save(); 
+  load_icons();
   
+#if PERF_STATS
+  // compare SINGLE_LAYER 0 and 1 with this
+  APP_LOG(APP_LOG_LEVEL_INFO, "heap used after window load: %d", (int)heap_bytes_used());
+#endif
   APP_LOG(APP_LOG_LEVEL_DEBUG, "main_window_load");
 }
 
 
-///////////////////////
-// update clock time //
-///////////////////////
-static void update_time() {
-  // get a tm strucutre
-  time_t temp = time(NULL);
-  struct tm *tick_time = localtime(&temp);
-  
-  // write date to buffer
-  static char date_buffer[32];
-  strftime(date_buffer, sizeof(date_buffer), "%e", tick_time);
-  
-  // write day to buffer
-  static char day_buffer[32];
-  char *weekday = day_buffer;
-  strftime(day_buffer, sizeof(day_buffer), "%w", tick_time);
-  
-  // make date all caps
-  if(strcmp(day_buffer, "0")==0) {
-    weekday = "SUN";
-  } else if(strcmp(day_buffer, "1")==0) {
-    weekday = "MON";
-  } else if(strcmp(day_buffer, "2")==0) {
-    weekday = "TUE";
-  } else if(strcmp(day_buffer, "3")==0) {
-    weekday = "WED";
-  } else if(strcmp(day_buffer, "4")==0) {
-    weekday = "THU";
-  } else if(strcmp(day_buffer, "5")==0) {
-    weekday = "FRI";
-  } else if(strcmp(day_buffer, "6")==0) {
-    weekday = "SAT";
-  } else {
-    weekday = "";
+////////////////////////////////////////////////
+// window shown again, previous frame is gone //
+////////////////////////////////////////////////
+static void main_window_appear(Window *window) {
+  s_full_redraw = true;
+}
+
+
+/////////////////////////
+// update day and date //
+/////////////////////////
+static void update_date(struct tm *tick_time) {
+  static const char *const weekdays[] = { "SUN", "MON", "TUE", "WED", "THU", "FRI", "SAT" };
+  static int shown_mday = -1, shown_wday = -1;
+  
+  // setting text marks the layer dirty even if it is the same
+  if(tick_time->tm_mday != shown_mday) {
+    static char date_buffer[4];
+    snprintf(date_buffer, sizeof(date_buffer), "%d", tick_time->tm_mday);
+    widget_set_text(WIDGET_DATE, s_date_text_layer, &s_date_text, date_buffer);
+    shown_mday = tick_time->tm_mday;
   }
   
-  // display this time on the text layer
-  text_layer_set_text(s_date_text_layer, date_buffer+(('0' == date_buffer[0]?1:0))); // remove padding
-  text_layer_set_text(s_day_text_layer, weekday); 
+  if(tick_time->tm_wday != shown_wday) {
+    widget_set_text(WIDGET_DATE, s_day_text_layer, &s_day_text,
+                    (tick_time->tm_wday >= 0 && tick_time->tm_wday < 7) ? weekdays[tick_time->tm_wday] : "");
+    shown_wday = tick_time->tm_wday;
+  }
 }
 
 
@@ -442,21 +849,31 @@ static void update_time() {
 // handle ticks //
 //////////////////
 static void tick_handler(struct tm *tick_time, TimeUnits units_changed) {
-  layer_mark_dirty(s_hands_layer);
-  update_time();
-  
-  // Get weather update every 30 minutes
-  if(tick_time->tm_min % 30 == 0) {
-    // Begin dictionary
-    DictionaryIterator *iter;
-    app_message_outbox_begin(&iter);
+  PERF_SCOPE(PERF_TICK_HANDLER);
+#if PERF_STATS
+  // report redraw work for the minute that just ended
+  APP_LOG(APP_LOG_LEVEL_DEBUG, "redraw pixels: %d", (int)s_redraw_pixels);
+  s_redraw_pixels = 0;
+#endif
+  
+  if(units_changed & MINUTE_UNIT) {
+    hands_set_time(tick_time);
+    layer_mark_dirty(SINGLE_LAYER ? s_dial_layer : s_hands_layer);
+  }
   
-    // Add a key-value pair
-    dict_write_uint8(iter, 0, 0);
+  // play back forecast, then let the scheduler decide if weather is due
+  forecast_update(time(NULL));
+  weather_scheduler_trigger(WEATHER_TRIGGER_TICK);
   
-    // Send the message!
-    app_message_outbox_send();
-  }  
+  if(units_changed & DAY_UNIT) {
+    update_date(tick_time);
+    health_day_changed();
+    
+    // how much radio traffic the scheduler saved today
+    WeatherSchedulerStats stats = weather_scheduler_get_stats();
+    APP_LOG(APP_LOG_LEVEL_INFO, "weather requests sent %d suppressed %d failed %d",
+            (int)stats.sent, (int)stats.suppressed, (int)stats.failed);
+  }
 }
 
 
@@ -464,14 +881,19 @@ static void tick_handler(struct tm *tick_time, TimeUnits units_changed) {
 // registers battery update events //
 /////////////////////////////////////
 static void battery_handler(BatteryChargeState charge_state) {
+  PERF_SCOPE(PERF_BATTERY_HANDLER);
   battery_percent = charge_state.charge_percent;
   if(charge_state.is_charging || charge_state.is_plugged) {
     charging = true;
   } else {
     charging = false;
   }
+#if !SINGLE_LAYER
+  // set visibility of charging icon
+  layer_set_hidden(bitmap_layer_get_layer(s_charging_bitmap_layer), !charging);
+#endif
   // force update to circle
-  layer_mark_dirty(s_battery_circle);
+  widget_mark_dirty(WIDGET_BATTERY, s_battery_circle);
 }
 
 
@@ -479,33 +901,30 @@ static void battery_handler(BatteryChargeState charge_state) {
 // manage bluetooth status //
 /////////////////////////////
 static void bluetooth_callback(bool connected) {
+  PERF_SCOPE(PERF_BLUETOOTH_CALLBACK);
+  s_bluetooth_connected = connected;
+#if SINGLE_LAYER
+  widget_mark_dirty(WIDGET_BATTERY, NULL);
+#else
   layer_set_hidden(bitmap_layer_get_layer(s_bluetooth_bitmap_layer), connected);
+#endif
   if(!connected) {
     vibes_double_pulse();
+  } else {
+    weather_scheduler_trigger(WEATHER_TRIGGER_RECONNECT);
   }
 }
 
 
-// registers health update events
-static void health_handler(HealthEventType event, void *context) {
-  if(event==HealthEventMovementUpdate) {
-    step_count = (double)health_service_sum_today(HealthMetricStepCount);
-    // write to char_current_steps variable
-    static char health_buf[32];
-    if(step_count>=1000) {
-      double s_c = step_count/1000;
-      snprintf(health_buf, sizeof(health_buf), "%dk", (int)s_c);
-    } else {
-      snprintf(health_buf, sizeof(health_buf), "%d", (int)step_count);
-    }
-    
-    char_current_steps = health_buf;
-    text_layer_set_text(s_health_layer, char_current_steps);
-    
-    // force update to circle
-    layer_mark_dirty(s_health_circle);
-    
-    APP_LOG(APP_LOG_LEVEL_INFO, "health_handler completed");
+////////////////////////////////////////
+// steps changed enough to be visible //
+////////////////////////////////////////
+static void health_changed(bool label_changed, bool ring_changed) {
+  if(label_changed) {
+    widget_set_text(WIDGET_HEALTH, s_health_layer, &s_health_text, health_get_label());
+  }
+  if(ring_changed) {
+    widget_mark_dirty(WIDGET_HEALTH, s_health_circle);
   }
 }
 
@@ -514,7 +933,13 @@ static void health_handler(HealthEventType event, void *context) {
 // unload window //
 ///////////////////
 static void main_window_unload(Window *window) {
+  dial_cache_destroy();
+  
+#if PERF_STATS && PERF_OVERLAY
+  layer_destroy(s_perf_layer);
+#endif
   layer_destroy(s_dial_layer);
+#if !SINGLE_LAYER
   layer_destroy(s_hands_layer);
   layer_destroy(s_temp_circle);
   layer_destroy(s_battery_circle);
@@ -525,274 +950,223 @@ static void main_window_unload(Window *window) {
   text_layer_destroy(s_day_text_layer);
   text_layer_destroy(s_date_text_layer);  
   
-  gbitmap_destroy(s_weather_bitmap);
-  gbitmap_destroy(s_health_bitmap);
-  gbitmap_destroy(s_bluetooth_bitmap);
-  gbitmap_destroy(s_charging_bitmap);
-  
   bitmap_layer_destroy(s_weather_bitmap_layer);
   bitmap_layer_destroy(s_health_bitmap_layer);
   bitmap_layer_destroy(s_bluetooth_bitmap_layer);
   bitmap_layer_destroy(s_charging_bitmap_layer);
+#endif
+  
+  s_weather_bitmap = s_health_bitmap = s_bluetooth_bitmap = s_charging_bitmap = NULL;
+  icon_pool_destroy();
+}
+
+
+////////////////////////////////////////////
+// swap the bitmap shown by a BitmapLayer //
+////////////////////////////////////////////
+static void icon_layer_set(Widget widget, BitmapLayer *layer, GBitmap **bitmap, uint32_t resource_id) {
+  GBitmap *icon = resource_id ? icon_pool_acquire(resource_id) : NULL;
+  
+  // already showing it, drop the extra reference
+  if(icon == *bitmap) {
+    icon_pool_release(icon);
+    return;
+  }
+  
+#if SINGLE_LAYER
+  widget_mark_dirty(widget, NULL);
+#else
+  bitmap_layer_set_bitmap(layer, icon);
+#endif
+  icon_pool_release(*bitmap);
+  *bitmap = icon;
 }
 
 
-//////////////////////////////////////////////////////
-// display appropriate weather icon                 //
-// works with DarkSky.net and OpenWeatherMap.org    //
-// https://darksky.net/dev/docs/response#data-point //
-// https://openweathermap.org/weather-conditions    //
-//////////////////////////////////////////////////////
+////////////////////////////////////////////////////////
+// display appropriate weather icon                   //
+// phone maps DarkSky.net and OpenWeatherMap.org      //
+// codes to a condition, see src/pkjs/conditions.json //
+////////////////////////////////////////////////////////
+static void weather_icon_load() {
+  uint32_t weather_icon = 0;
+  if(s_condition < WEATHER_CONDITION_COUNT) {
+    weather_icon = WEATHER_CONDITION_ICONS[s_condition];
+  }
+  icon_layer_set(WIDGET_TEMP, s_weather_bitmap_layer, &s_weather_bitmap, weather_icon);
+}
+
+
+///////////////////////////////////////
+// load every icon shown on the dial //
+///////////////////////////////////////
 static void load_icons() {
+  // populate icons, pool hands back the same bitmap if it is already loaded
+  weather_icon_load();
+  icon_layer_set(WIDGET_HEALTH, s_health_bitmap_layer, &s_health_bitmap, RESOURCE_ID_SHOE_ICON);
+  icon_layer_set(WIDGET_BATTERY, s_charging_bitmap_layer, &s_charging_bitmap, RESOURCE_ID_LIGHTENING_ICON);
+  icon_layer_set(WIDGET_BATTERY, s_bluetooth_bitmap_layer, &s_bluetooth_bitmap, RESOURCE_ID_BLUETOOTH_DISCONNECTED_ICON);
+}
+
+
+////////////////////////////////////////////
+// write shown temperature in chosen unit //
+////////////////////////////////////////////
+static void temp_render() {
+  if(!s_temp_valid) {
+    return;
+  }
+  static char temp_buf[32];
+  char text[sizeof(temp_buf)];
+  snprintf(text, sizeof(text), "%d°", settings.Celsius ? s_temp_c : s_temp_f);
   
-  // if inverted
-  if(settings.InvertColors) {
-    // populate icon variable
-    
-    // DS clear-day
-    // OW 01d (clear sky, day)
-    
-    if(strcmp(icon_buf, "clear-day")==0 || 
-       strcmp(icon_buf, "01d")==0) {
-      s_weather_bitmap = gbitmap_create_with_resource(RESOURCE_ID_CLEAR_SKY_DAY_BLACK_ICON);  
-      
-    // DS clear-night
-    // OW 01n (clear sky, night)
-      
-    } else if(strcmp(icon_buf, "clear-night")==0 || 
-              strcmp(icon_buf, "01n")==0) {
-      s_weather_bitmap = gbitmap_create_with_resource(RESOURCE_ID_CLEAR_SKY_NIGHT_BLACK_ICON);
-      
-    // DS rain
-    // OW 09d (shower rain, day)
-    // OW 09n (shower rain, night)
-    // OW 10d (rain, day)
-    // OW 10n (rain, night)
-    // OW 11d (thunderstorm, day)
-    // OW 11n (thunderstorm, night)
-      
-    } else if(strcmp(icon_buf, "rain")==0 ||
-             strcmp(icon_buf, "09d")==0 || 
-             strcmp(icon_buf, "09n")==0 || 
-             strcmp(icon_buf, "10d")==0 || 
-             strcmp(icon_buf, "10n")==0 || 
-             strcmp(icon_buf, "11d")==0 || 
-             strcmp(icon_buf, "11n")==0) {
-      s_weather_bitmap = gbitmap_create_with_resource(RESOURCE_ID_RAIN_BLACK_ICON);
-      
-    // OW 50d (mist, day)
-      
-    } else if(strcmp(icon_buf, "50d")==0) {
-      s_weather_bitmap = gbitmap_create_with_resource(RESOURCE_ID_MIST_DAY_BLACK_ICON);
-      
-    // OW 50n (mist, night)
-      
-    } else if(strcmp(icon_buf, "50n")==0) {
-      s_weather_bitmap = gbitmap_create_with_resource(RESOURCE_ID_MIST_NIGHT_BLACK_ICON);
-      
-    // DS snow
-    // OW 13d (snow, day)
-    // OW 13n (snow, night)
-      
-    } else if(strcmp(icon_buf, "snow")==0 || 
-              strcmp(icon_buf, "13d")==0 || 
-              strcmp(icon_buf, "13n")==0) {
-      s_weather_bitmap = gbitmap_create_with_resource(RESOURCE_ID_SNOW_BLACK_ICON);
-      
-    // DS sleet
-      
-    } else if(strcmp(icon_buf, "sleet")==0) {
-      s_weather_bitmap = gbitmap_create_with_resource(RESOURCE_ID_SLEET_BLACK_ICON);
-      
-    // DS wind
-      
-    } else if(strcmp(icon_buf, "wind")==0) {
-      s_weather_bitmap = gbitmap_create_with_resource(RESOURCE_ID_WIND_BLACK_ICON);
-      
-    // DS fog
-      
-    } else if(strcmp(icon_buf, "fog")==0) {
-      s_weather_bitmap = gbitmap_create_with_resource(RESOURCE_ID_FOG_BLACK_ICON);
-      
-    // DS cloudy
-      
-    } else if(strcmp(icon_buf, "cloudy")==0) {
-      s_weather_bitmap = gbitmap_create_with_resource(RESOURCE_ID_CLOUDY_BLACK_ICON);
-      
-    // DS partly-cloudy-day
-    // OW 02d (few clouds, day)
-    // OW 03d (scattered clouds, day)
-    // OW 04d (broken clouds, day)
-      
-    } else if(strcmp(icon_buf, "partly-cloudy-day")==0 || 
-              strcmp(icon_buf, "02d")==0 || 
-              strcmp(icon_buf, "03d")==0 || 
-              strcmp(icon_buf, "04d")==0) {
-      s_weather_bitmap = gbitmap_create_with_resource(RESOURCE_ID_PARTLY_CLOUDY_DAY_BLACK_ICON);
-      
-    // DS partly-cloudy-night
-    // OW 02d (few clouds, night)
-    // OW 03d (scattered clouds, night)
-    // OW 04d (broken clouds, night)      
-      
-    } else if(strcmp(icon_buf, "partly-cloudy-night")==0 || 
-              strcmp(icon_buf, "02n")==0 || 
-              strcmp(icon_buf, "03n")==0 || 
-              strcmp(icon_buf, "04n")==0) {
-      s_weather_bitmap = gbitmap_create_with_resource(RESOURCE_ID_PARTLY_CLOUDY_NIGHT_BLACK_ICON);
-    } 
-    
-  } else {
-  // not inverted
-  // populate icon variable
-    
-    // DS clear-day
-    // OW 01d (clear sky, day)    
-    
-    if(strcmp(icon_buf, "clear-day")==0 || 
-       strcmp(icon_buf, "01d")==0) {
-      s_weather_bitmap = gbitmap_create_with_resource(RESOURCE_ID_CLEAR_SKY_DAY_WHITE_ICON);  
-      
-    // DS clear-night
-    // OW 01n (clear sky, night)
-      
-    } else if(strcmp(icon_buf, "clear-night")==0 || 
-              strcmp(icon_buf, "01n")==0) {
-      s_weather_bitmap = gbitmap_create_with_resource(RESOURCE_ID_CLEAR_SKY_NIGHT_WHITE_ICON);
-      
-    // DS rain
-    // OW 09d (shower rain, day)
-    // OW 09n (shower rain, night)
-    // OW 10d (rain, day)
-    // OW 10n (rain, night)
-    // OW 11d (thunderstorm, day)
-    // OW 11n (thunderstorm, night)
-      
-    } else if(strcmp(icon_buf, "rain")==0 ||
-             strcmp(icon_buf, "09d")==0 || 
-             strcmp(icon_buf, "09n")==0 || 
-             strcmp(icon_buf, "10d")==0 || 
-             strcmp(icon_buf, "10n")==0 || 
-             strcmp(icon_buf, "11d")==0 || 
-             strcmp(icon_buf, "11n")==0) {
-      s_weather_bitmap = gbitmap_create_with_resource(RESOURCE_ID_RAIN_WHITE_ICON);
-      
-    // OW 50d (mist, day)
-      
-    } else if(strcmp(icon_buf, "50d")==0) {
-      s_weather_bitmap = gbitmap_create_with_resource(RESOURCE_ID_MIST_DAY_WHITE_ICON);
-      
-    // OW 50n (mist, night)
-      
-    } else if(strcmp(icon_buf, "50n")==0) {
-      s_weather_bitmap = gbitmap_create_with_resource(RESOURCE_ID_MIST_NIGHT_WHITE_ICON);      
-      
-    // DS snow
-    // OW 13d (snow, day)
-    // OW 13n (snow, night)
-      
-    } else if(strcmp(icon_buf, "snow")==0 || 
-              strcmp(icon_buf, "13d")==0 || 
-              strcmp(icon_buf, "13n")==0) {
-      s_weather_bitmap = gbitmap_create_with_resource(RESOURCE_ID_SNOW_WHITE_ICON);
-      
-    // DS sleet
-      
-    } else if(strcmp(icon_buf, "sleet")==0) {
-      s_weather_bitmap = gbitmap_create_with_resource(RESOURCE_ID_SLEET_WHITE_ICON);
-      
-    // DS wind
-      
-    } else if(strcmp(icon_buf, "wind")==0) {
-      s_weather_bitmap = gbitmap_create_with_resource(RESOURCE_ID_WIND_WHITE_ICON);
-      
-    // DS fog
-      
-    } else if(strcmp(icon_buf, "fog")==0) {
-      s_weather_bitmap = gbitmap_create_with_resource(RESOURCE_ID_FOG_WHITE_ICON);
-      
-    // DS cloudy
-      
-    } else if(strcmp(icon_buf, "cloudy")==0) {
-      s_weather_bitmap = gbitmap_create_with_resource(RESOURCE_ID_CLOUDY_WHITE_ICON);
-      
-    // DS partly-cloudy-day
-    // OW 02d (few clouds, day)
-    // OW 03d (scattered clouds, day)
-    // OW 04d (broken clouds, day)
-      
-    } else if(strcmp(icon_buf, "partly-cloudy-day")==0 || 
-              strcmp(icon_buf, "02d")==0 || 
-              strcmp(icon_buf, "03d")==0 || 
-              strcmp(icon_buf, "04d")==0) {
-      s_weather_bitmap = gbitmap_create_with_resource(RESOURCE_ID_PARTLY_CLOUDY_DAY_WHITE_ICON);
-      
-    // DS partly-cloudy-night
-    // OW 02d (few clouds, night)
-    // OW 03d (scattered clouds, night)
-    // OW 04d (broken clouds, night)
-      
-    } else if(strcmp(icon_buf, "partly-cloudy-night")==0 || 
-              strcmp(icon_buf, "02n")==0 || 
-              strcmp(icon_buf, "03n")==0 || 
-              strcmp(icon_buf, "04n")==0) {
-      s_weather_bitmap = gbitmap_create_with_resource(RESOURCE_ID_PARTLY_CLOUDY_NIGHT_WHITE_ICON);
-    }   
-  }
-  
-  // populate weather icon
-  if(s_weather_bitmap_layer) {
-    bitmap_layer_destroy(s_weather_bitmap_layer);
-  }
-  s_weather_bitmap_layer = bitmap_layer_create(GRect(PBL_IF_ROUND_ELSE(78, 60), 35, 24, 16));
-  bitmap_layer_set_compositing_mode(s_weather_bitmap_layer, GCompOpSet);  
-  bitmap_layer_set_bitmap(s_weather_bitmap_layer, s_weather_bitmap); 
-  layer_add_child(s_dial_layer, bitmap_layer_get_layer(s_weather_bitmap_layer)); 
-  
-  // populate health icon
-  if(s_health_bitmap_layer) {
-    bitmap_layer_destroy(s_health_bitmap_layer);
-  }
-  if(settings.InvertColors) {
-    s_health_bitmap = gbitmap_create_with_resource(RESOURCE_ID_SHOE_BLACK_ICON);
-  } else {
-    s_health_bitmap = gbitmap_create_with_resource(RESOURCE_ID_SHOE_WHITE_ICON);
+  // same text would still mark the layer dirty
+  if(strcmp(text, temp_buf) == 0) {
+    return;
+  }
+  strcpy(temp_buf, text);
+  widget_set_text(WIDGET_TEMP, s_temp_layer, &s_temp_text, temp_buf);
+}
+
+
+////////////////////////////////////
+// show temperature and condition //
+////////////////////////////////////
+static void weather_show(int temp_f, int temp_c, uint8_t condition) {
+  // both units are kept so a unit change redraws without asking the phone
+  s_temp_f = temp_f;
+  s_temp_c = temp_c;
+  s_temp_valid = true;
+  temp_render();
+  
+  // icon only changes with the condition
+  if(condition != s_condition) {
+    s_condition = condition;
+    weather_icon_load();
+  }
+}
+
+
+//////////////////////////////////////
+// show last reading saved in flash //
+//////////////////////////////////////
+static void weather_load() {
+  WeatherSnapshot snapshot;
+  if(persist_read_data(WEATHER_KEY, &snapshot, sizeof(snapshot)) != sizeof(snapshot) ||
+     snapshot.weather.version != WEATHER_PAYLOAD_VERSION) {
+    return;
+  }
+  s_weather = snapshot.weather;
+  s_weather_received = snapshot.received;
+  weather_show(s_weather.temp_f, s_weather.temp_c, s_weather.condition);
+}
+
+
+//////////////////////////////////
+// read forecast saved in flash //
+//////////////////////////////////
+static void forecast_load() {
+  memset(&s_forecast, 0, sizeof(s_forecast));
+  if(persist_read_data(FORECAST_KEY, &s_forecast, sizeof(s_forecast)) < (int)FORECAST_HEADER_SIZE ||
+     s_forecast.version != FORECAST_PAYLOAD_VERSION || s_forecast.count > FORECAST_MAX_ENTRIES) {
+    s_forecast.count = 0;
   }
-  s_health_bitmap_layer = bitmap_layer_create(GRect(PBL_IF_ROUND_ELSE(78, 60), PBL_IF_ROUND_ELSE(143, 131), 24, 16));
-  bitmap_layer_set_compositing_mode(s_health_bitmap_layer, GCompOpSet);
-  bitmap_layer_set_bitmap(s_health_bitmap_layer, s_health_bitmap); 
-  layer_add_child(s_dial_layer, bitmap_layer_get_layer(s_health_bitmap_layer));  
+  s_forecast_slot = -1;
+}
+
+
+////////////////////////////////
+// time the forecast runs out //
+////////////////////////////////
+static time_t forecast_end() {
+  return s_forecast.start + (s_forecast.count * s_forecast.step * SECONDS_PER_MINUTE);
+}
+
+
+//////////////////////////////////////////
+// switch to forecast slot covering now //
+//////////////////////////////////////////
+static void forecast_update(time_t now) {
+  if(s_forecast.count == 0 || s_forecast.step == 0 || now < (time_t)s_forecast.start) {
+    return;
+  }
+  
+  int slot = (now - s_forecast.start) / (s_forecast.step * SECONDS_PER_MINUTE);
+  if(slot >= s_forecast.count || slot == s_forecast_slot) {
+    return;
+  }
+  s_forecast_slot = slot;
+  
+  // a live reading taken inside this slot is better than the forecast
+  time_t slot_start = s_forecast.start + (slot * s_forecast.step * SECONDS_PER_MINUTE);
+  if((time_t)s_weather.observed >= slot_start) {
+    return;
+  }
+  
+  const ForecastEntry *entry = &s_forecast.entries[slot];
+  weather_show(entry->temp_f, entry->temp_c, entry->condition);
 }
 
 
 ////////////////////////////
-// weather and Clay calls //
+// new weather from phone //
 ////////////////////////////
-static void inbox_received_callback(DictionaryIterator *iterator, void *context) {
-  // Store incoming information
-  static char temp_buf[32];
-
-  // Read tuples for data
-  Tuple *temp_tuple = dict_find(iterator, MESSAGE_KEY_KEY_TEMP);
-  Tuple *icon_tuple = dict_find(iterator, MESSAGE_KEY_KEY_ICON);  
+static void weather_received(const Tuple *weather_tuple) {
+  // only use it if it is the layout we know
+  if(weather_tuple->length < sizeof(WeatherPayload) ||
+     weather_tuple->value->data[0] != WEATHER_PAYLOAD_VERSION) {
+    APP_LOG(APP_LOG_LEVEL_WARNING, "Unknown weather payload version %d", (int)weather_tuple->value->data[0]);
+    return;
+  }
   
-  // If all data is available, use it
-  if(temp_tuple && icon_tuple) {
-    
-    // temp
-    snprintf(temp_buf, sizeof(temp_buf), "%d°", (int)temp_tuple->value->int32);  
-    text_layer_set_text(s_temp_layer, temp_buf);
+  WeatherPayload previous = s_weather;
+  memcpy(&s_weather, weather_tuple->value->data, sizeof(WeatherPayload));
+  weather_scheduler_received(previous.temp_f != s_weather.temp_f ||
+                             previous.condition != s_weather.condition);
+  
+  // keep it for the next launch
+  s_weather_received = time(NULL);
+  WeatherSnapshot snapshot = { .weather = s_weather, .received = s_weather_received };
+  persist_write_data(WEATHER_KEY, &snapshot, sizeof(snapshot));
+  
+  weather_show(s_weather.temp_f, s_weather.temp_c, s_weather.condition);
+}
+
 
-    // icon
-    snprintf(icon_buf, sizeof(icon_buf), "%s", icon_tuple->value->cstring);
-  }  
+/////////////////////////////
+// new forecast from phone //
+/////////////////////////////
+static void forecast_received(const Tuple *forecast_tuple) {
+  if(forecast_tuple->length < FORECAST_HEADER_SIZE ||
+     forecast_tuple->length > sizeof(ForecastPayload) ||
+     forecast_tuple->value->data[0] != FORECAST_PAYLOAD_VERSION) {
+    APP_LOG(APP_LOG_LEVEL_WARNING, "Unknown forecast payload");
+    return;
+  }
   
-  // load weather icons
-  load_icons();
+  // forecast timeline, kept in flash and played back from tick_handler
+  memset(&s_forecast, 0, sizeof(s_forecast));
+  memcpy(&s_forecast, forecast_tuple->value->data, forecast_tuple->length);
+  s_forecast.count = MIN(s_forecast.count, (forecast_tuple->length - FORECAST_HEADER_SIZE) / sizeof(ForecastEntry));
+  persist_write_data(FORECAST_KEY, &s_forecast, forecast_tuple->length);
+  
+  // timeline covers us for a while, no need to ask again soon
+  s_forecast_slot = -1;
+  weather_scheduler_covered_until(forecast_end());
+}
+
+
+////////////////////////////
+// new settings from Clay //
+////////////////////////////
+static void settings_received(DictionaryIterator *iterator) {
+  ClaySettings previous = settings;
   
   // determine if user inverted colors
   Tuple *invert_colors_t = dict_find(iterator, MESSAGE_KEY_KEY_INVERT_COLORS);
-  if(invert_colors_t) { settings.InvertColors = invert_colors_t->value->int32 == 1; }
+  if(invert_colors_t) {
+    settings.InvertColors = invert_colors_t->value->int32 == 1;
+  }
   
   if(settings.InvertColors==1) {
     settings.BackgroundColor = GColorWhite;
@@ -802,8 +1176,47 @@ static void inbox_received_callback(DictionaryIterator *iterator, void *context)
     settings.ForegroundColor = GColorWhite;
   }
   
-	setColors();	
-	config_save();
+  Tuple *temp_unit_t = dict_find(iterator, MESSAGE_KEY_KEY_TEMP_UNIT);
+  if(temp_unit_t) {
+    settings.Celsius = temp_unit_t->value->int32 == 1;
+  }
+  
+  // Clay resends every setting, only touch flash when something changed
+  if(memcmp(&previous, &settings, sizeof(settings)) == 0) {
+    return;
+  }
+  config_save();
+  
+  if(previous.InvertColors != settings.InvertColors) {
+    setColors();
+    weather_scheduler_trigger(WEATHER_TRIGGER_CONFIG);
+  }
+  
+  // unit change is redrawn from the reading we already have
+  if(previous.Celsius != settings.Celsius) {
+    temp_render();
+  }
+}
+
+
+//////////////////////////////////////
+// dispatch phone and Clay messages //
+//////////////////////////////////////
+static void inbox_received_callback(DictionaryIterator *iterator, void *context) {
+  PERF_SCOPE(PERF_INBOX);
+  Tuple *weather_tuple = dict_find(iterator, MESSAGE_KEY_KEY_WEATHER);
+  if(weather_tuple) {
+    weather_received(weather_tuple);
+  }
+  
+  Tuple *forecast_tuple = dict_find(iterator, MESSAGE_KEY_KEY_FORECAST);
+  if(forecast_tuple) {
+    forecast_received(forecast_tuple);
+  }
+  
+  if(dict_find(iterator, MESSAGE_KEY_KEY_INVERT_COLORS) || dict_find(iterator, MESSAGE_KEY_KEY_TEMP_UNIT)) {
+    settings_received(iterator);
+  }
   
   APP_LOG(APP_LOG_LEVEL_INFO, "inbox_received_callback");
 }
@@ -816,11 +1229,24 @@ static void inbox_dropped_callback(AppMessageResult reason, void *context) {
 
 static void outbox_failed_callback(DictionaryIterator *iterator, AppMessageResult reason, void *context) {
   APP_LOG(APP_LOG_LEVEL_ERROR, "Outbox send failed!");
+#if PERF_STATS
+  // a stats dump, not a weather request
+  if(dict_find(iterator, MESSAGE_KEY_KEY_PERF_STATS)) {
+    return;
+  }
+#endif
+  weather_scheduler_failed();
 }
 
 
 static void outbox_sent_callback(DictionaryIterator *iterator, void *context) {
   APP_LOG(APP_LOG_LEVEL_INFO, "Outbox send success!");
+#if PERF_STATS
+  if(dict_find(iterator, MESSAGE_KEY_KEY_PERF_STATS)) {
+    return;
+  }
+#endif
+  weather_scheduler_sent();
 }
 
 
@@ -833,6 +1259,7 @@ static void init() {
   s_main_window = window_create();
   window_set_window_handlers(s_main_window, (WindowHandlers) {
     .load = main_window_load,
+    .appear = main_window_appear,
     .unload = main_window_unload
   });
   
@@ -842,19 +1269,26 @@ static void init() {
   // subscribe to time events
   tick_timer_service_subscribe(MINUTE_UNIT, tick_handler);
   
-  // Make sure the time is displayed from the start
-  update_time();
+  // Make sure the date is displayed from the start, after that it only changes on DAY_UNIT
+  time_t now = time(NULL);
+  update_date(localtime(&now));
     
-  // subscribe to health events 
-  health_service_events_subscribe(health_handler, NULL); 
-  // force initial update
-  health_handler(HealthEventMovementUpdate, NULL);   
+  // step count, throttled and only reporting visible changes
+  health_init(health_changed);
     
   // register with Battery State Service
   battery_state_service_subscribe(battery_handler);
   // force initial update
   battery_handler(battery_state_service_peek());      
   
+  // weather refresh schedule, before bluetooth so reconnects can use it
+  // skip the launch fetch while the saved reading or forecast is still good
+  weather_scheduler_init(s_weather_received);
+  if(s_forecast.count > 0) {
+    weather_scheduler_covered_until(forecast_end());
+  }
+  weather_scheduler_trigger(WEATHER_TRIGGER_LAUNCH);
+  
   // register with bluetooth state service
   connection_service_subscribe((ConnectionHandlers) {
     .pebble_app_connection_handler = bluetooth_callback
@@ -866,7 +1300,21 @@ static void init() {
   app_message_register_inbox_dropped(inbox_dropped_callback);
   app_message_register_outbox_failed(outbox_failed_callback);
   app_message_register_outbox_sent(outbox_sent_callback);  
-  app_message_open(128, 128);  
+  
+  // size buffers for the largest message each way, weather or Clay settings
+  uint32_t settings_size = dict_calc_buffer_size(0) +
+                           ((SETTINGS_MESSAGE_KEYS + SETTINGS_SPARE_KEYS) * (sizeof(Tuple) + sizeof(int32_t)));
+  uint32_t inbox_size = MAX(dict_calc_buffer_size(2, sizeof(WeatherPayload), sizeof(ForecastPayload)),
+                            settings_size);
+  uint32_t outbox_size = dict_calc_buffer_size(1, sizeof(uint8_t)); // KEY_REQUEST_WEATHER
+#if PERF_STATS
+  outbox_size = MAX(outbox_size, dict_calc_buffer_size(1, PERF_DUMP_SIZE));
+#endif
+  app_message_open(inbox_size, outbox_size);  
+
+#if PERF_STATS
+  perf_init();
+#endif
   
   APP_LOG(APP_LOG_LEVEL_DEBUG, "init");  
 }
@@ -876,6 +1324,11 @@ static void init() {
 // de-initialize app //
 ///////////////////////
 static void deinit() {
+#if PERF_STATS
+  perf_deinit();
+#endif
+  weather_scheduler_deinit();
+  health_deinit();
   window_destroy(s_main_window);
 }
 
@@ -887,4 +1340,5 @@ int main(void) {
   init();
   app_event_loop();
   deinit();
+  return 0;
 }
\ No newline at end of file
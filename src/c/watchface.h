@@ -4,8 +4,45 @@
 ///////////////////////
 // weather variables //
 ///////////////////////
-#define KEY_TEMP
-#define KEY_ICON
+// phone sends weather as one KEY_WEATHER byte array holding this struct,
+// little endian, encoded by src/pkjs/protocol.js
+#define WEATHER_PAYLOAD_VERSION 1
+#define WEATHER_FLAG_CACHED (1 << 0) // phone resent a reading it already had
+
+typedef struct __attribute__((__packed__)) WeatherPayload {
+  uint8_t version;
+  uint8_t flags;
+  uint8_t condition; // WeatherCondition
+  int16_t temp_f;
+  int16_t temp_c;
+  uint32_t observed; // unix time of the reading
+} WeatherPayload;
+
+// forecast timeline, sent as KEY_FORECAST with only count entries filled
+#define FORECAST_PAYLOAD_VERSION 1
+#define FORECAST_MAX_ENTRIES 24
+
+typedef struct __attribute__((__packed__)) ForecastEntry {
+  uint8_t condition; // WeatherCondition
+  int16_t temp_f;
+  int16_t temp_c;
+} ForecastEntry;
+
+typedef struct __attribute__((__packed__)) ForecastPayload {
+  uint8_t version;
+  uint8_t count;
+  uint16_t step; // minutes between entries
+  uint32_t start; // unix time of first entry
+  ForecastEntry entries[FORECAST_MAX_ENTRIES];
+} ForecastPayload;
+
+// last reading kept in flash so it shows right away at launch
+typedef struct WeatherSnapshot {
+  WeatherPayload weather;
+  uint32_t received; // unix time the watch got it
+} WeatherSnapshot;
+
+#define FORECAST_HEADER_SIZE (sizeof(ForecastPayload) - sizeof(((ForecastPayload *)0)->entries))
 
 ////////////////////
 // font variables //
@@ -15,6 +52,53 @@
 
 #define SETTINGS_KEY 1
 
+// Clay sends every messageKey in src/pkjs/config.js in one message, an
+// int32 each for toggles and colors. Keep this in step with config.js,
+// tools/pkjs/config.test.js fails when it is not. The spare tuples keep
+// a setting added without updating it from getting the message dropped.
+#define SETTINGS_MESSAGE_KEYS 2
+#define SETTINGS_SPARE_KEYS 2
+#define FORECAST_KEY 2
+#define WEATHER_KEY 3
+
+////////////////////
+// hand positions //
+////////////////////
+#define MINUTE_POSITIONS 60
+#define HOUR_POSITIONS 72 // 12 hours, moving every 10 minutes
+
+typedef struct HandOffset {
+  int8_t x;
+  int8_t y;
+} HandOffset; // offset from center of the dial
+
+#define HAND_MARGIN 5 // half the widest hand stroke plus antialiasing
+
+// only restore the dial where the hands moved each minute instead of
+// repainting the whole screen, 0 draws every frame in full
+#ifndef PARTIAL_REDRAW
+#define PARTIAL_REDRAW 1
+#endif
+
+// draw dial, widgets, text and icons from one update proc instead of
+// the layer tree, each widget only redrawn when it changed
+#ifndef SINGLE_LAYER
+#define SINGLE_LAYER 0
+#endif
+
+typedef enum Widget {
+  WIDGET_TEMP, // temperature circle, text and weather icon
+  WIDGET_BATTERY, // battery ring, charging and bluetooth icons
+  WIDGET_HEALTH, // step ring, text and shoe
+  WIDGET_DATE, // day and date box
+  WIDGET_COUNT
+} Widget;
+
+typedef struct HandSegment {
+  HandOffset start;
+  HandOffset end;
+} HandSegment;
+
 ///////////////////
 // Clay settings //
 ///////////////////
@@ -22,25 +106,59 @@ typedef struct ClaySettings {
 	GColor BackgroundColor;
   GColor ForegroundColor;
   bool InvertColors;
+  bool Celsius; // show temp_c instead of temp_f
 } ClaySettings; // Define our settings struct
 
 static void config_default();
 static void config_load();
+static GCompOp icon_compositing();
 static void setColors();
 static void config_save();
+static void dial_cache_capture(GContext *ctx);
+static void dial_cache_destroy();
+#if PARTIAL_REDRAW || SINGLE_LAYER
+static void dial_cache_restore(GContext *ctx, GRect rect);
+#endif
+static void dial_redraw_done(GRect bounds);
 static void dial_update_proc(Layer *layer, GContext *ctx);
 static void temp_update_proc(Layer *layer, GContext *ctx);
 static void battery_update_proc(Layer *layer, GContext *ctx);
 static void health_update_proc(Layer *layer, GContext *ctx);
+static HandSegment hand_segment(int angle, int start, int end);
+static void hand_tables_init(GRect bounds);
+static GRect hand_rect(const HandSegment *hand);
+static GRect rect_union(GRect a, GRect b);
+static void hands_set_time(struct tm *tick_time);
 static void ticks_update_proc(Layer *layer, GContext *ctx);
+static void widget_mark_dirty(Widget widget, Layer *layer);
+static void widget_set_text(Widget widget, TextLayer *layer, const char **shown, const char *text);
+#if SINGLE_LAYER
+static bool rect_intersects(GRect a, GRect b);
+static void text_draw(GContext *ctx, const char *text, GFont font, GRect frame);
+static void icon_draw(GContext *ctx, GBitmap *bitmap, GRect frame);
+static void widget_draw(GContext *ctx, Widget widget);
+static void compositor_update_proc(Layer *layer, GContext *ctx);
+#endif
 static void main_window_load(Window *window);
-static void update_time();
+static void main_window_appear(Window *window);
+static void update_date(struct tm *tick_time);
 static void tick_handler(struct tm *tick_time, TimeUnits units_changed);
 static void battery_handler(BatteryChargeState charge_state);
 static void bluetooth_callback(bool connected);
-static void health_handler(HealthEventType event, void *context);
+static void health_changed(bool label_changed, bool ring_changed);
 static void main_window_unload(Window *window);
+static void icon_layer_set(Widget widget, BitmapLayer *layer, GBitmap **bitmap, uint32_t resource_id);
+static void temp_render();
+static void weather_show(int temp_f, int temp_c, uint8_t condition);
+static void weather_load();
+static time_t forecast_end();
+static void forecast_load();
+static void forecast_update(time_t now);
+static void weather_icon_load();
 static void load_icons();
+static void weather_received(const Tuple *weather_tuple);
+static void forecast_received(const Tuple *forecast_tuple);
+static void settings_received(DictionaryIterator *iterator);
 static void inbox_received_callback(DictionaryIterator *iterator, void *context);
 static void inbox_dropped_callback(AppMessageResult reason, void *context);
 static void outbox_failed_callback(DictionaryIterator *iterator, AppMessageResult reason, void *context);
@@ -0,0 +1,205 @@
+// Decides when the watch asks the phone for weather. Requests are skipped
+// while the phone is away, triggers close together are merged into one
+// request, failures are retried with backoff and jitter, and the interval
+// grows while readings keep coming back the same.
+
+
+#include <pebble.h>
+#include "perf.h"
+#include "weather_scheduler.h"
+
+
+static AppTimer *s_timer;
+static time_t s_next_due;
+static int s_interval = WEATHER_INTERVAL_MIN;
+static int s_retries;
+static bool s_in_flight, s_missed;
+static WeatherSchedulerStats s_stats;
+
+
+////////////////////////////////////////
+// push next refresh out one interval //
+////////////////////////////////////////
+static void scheduler_reset_due() {
+  s_next_due = time(NULL) + (s_interval * SECONDS_PER_MINUTE);
+}
+
+
+/////////////////////////////////////////
+// ask the phone for weather right now //
+/////////////////////////////////////////
+static void scheduler_send(void *data) {
+  PERF_SCOPE(PERF_WEATHER_TIMER);
+  s_timer = NULL;
+  
+  if(!connection_service_peek_pebble_app_connection()) {
+    s_missed = true;
+    s_stats.suppressed++;
+    return;
+  }
+  
+  if(s_in_flight) {
+    s_stats.suppressed++;
+    return;
+  }
+  
+  DictionaryIterator *iter;
+  AppMessageResult result = app_message_outbox_begin(&iter);
+  if(result == APP_MSG_OK) {
+    dict_write_uint8(iter, MESSAGE_KEY_KEY_REQUEST_WEATHER, 1);
+    result = app_message_outbox_send();
+  }
+  
+  if(result != APP_MSG_OK) {
+    APP_LOG(APP_LOG_LEVEL_WARNING, "weather request not sent: %d", (int)result);
+    weather_scheduler_failed();
+    return;
+  }
+  
+  s_in_flight = true;
+  s_missed = false;
+  s_stats.sent++;
+}
+
+
+///////////////////////////////////////////////
+// request after delay, merging with pending //
+///////////////////////////////////////////////
+static void scheduler_request(uint32_t delay_ms) {
+  if(s_timer || s_in_flight) {
+    s_stats.suppressed++;
+    return;
+  }
+  s_timer = app_timer_register(delay_ms, scheduler_send, NULL);
+}
+
+
+/////////////////////////
+// set up the schedule //
+/////////////////////////
+void weather_scheduler_init(time_t last_update) {
+  srand(time(NULL));
+  
+  // next refresh is one interval after the reading we already have
+  s_next_due = last_update + (s_interval * SECONDS_PER_MINUTE);
+}
+
+
+void weather_scheduler_deinit() {
+  if(s_timer) {
+    app_timer_cancel(s_timer);
+    s_timer = NULL;
+  }
+}
+
+
+//////////////////////////////////////////////
+// something happened that may want weather //
+//////////////////////////////////////////////
+void weather_scheduler_trigger(WeatherTrigger trigger) {
+  bool due = time(NULL) >= s_next_due;
+  
+  switch(trigger) {
+    case WEATHER_TRIGGER_TICK:
+      if(!due) {
+        return;
+      }
+      // a pending request or backoff retry already covers this minute,
+      // counting each tick would log requests that never existed
+      if(s_timer || s_in_flight) {
+        return;
+      }
+      // only count one suppressed request per disconnect
+      if(!connection_service_peek_pebble_app_connection()) {
+        if(!s_missed) {
+          s_missed = true;
+          s_stats.suppressed++;
+        }
+        return;
+      }
+      break;
+    case WEATHER_TRIGGER_LAUNCH:
+      if(due) {
+        scheduler_request(WEATHER_LAUNCH_MS);
+      }
+      return;
+    case WEATHER_TRIGGER_RECONNECT:
+    case WEATHER_TRIGGER_CONFIG:
+      if(!due && !s_missed) {
+        return;
+      }
+      break;
+  }
+  
+  scheduler_request(WEATHER_COALESCE_MS);
+}
+
+
+//////////////////////////////////
+// phone acknowledged a request //
+//////////////////////////////////
+void weather_scheduler_sent() {
+  if(!s_in_flight) {
+    return;
+  }
+  s_in_flight = false;
+  s_retries = 0;
+  scheduler_reset_due();
+}
+
+
+////////////////////////////////////////
+// request failed, retry with backoff //
+////////////////////////////////////////
+void weather_scheduler_failed() {
+  s_in_flight = false;
+  s_stats.failed++;
+  
+  uint32_t delay = WEATHER_RETRY_MS << (s_retries < 7 ? s_retries : 7);
+  if(delay > WEATHER_RETRY_MAX_MS) {
+    delay = WEATHER_RETRY_MAX_MS;
+  }
+  // spread retries so they do not line up with other traffic
+  delay += rand() % (delay / 2 + 1);
+  s_retries++;
+  
+  if(s_timer) {
+    app_timer_cancel(s_timer);
+  }
+  s_timer = app_timer_register(delay, scheduler_send, NULL);
+}
+
+
+////////////////////////////////////////////////
+// weather arrived, stretch if it is the same //
+////////////////////////////////////////////////
+void weather_scheduler_received(bool changed) {
+  if(changed) {
+    s_interval = WEATHER_INTERVAL_MIN;
+  } else if(s_interval < WEATHER_INTERVAL_MAX) {
+    s_interval = s_interval * 2 > WEATHER_INTERVAL_MAX ? WEATHER_INTERVAL_MAX : s_interval * 2;
+  }
+  s_missed = false;
+  scheduler_reset_due();
+}
+
+
+/////////////////////////////////////////////////
+// forecast on the watch lasts until this time //
+/////////////////////////////////////////////////
+void weather_scheduler_covered_until(time_t until) {
+  // refresh an hour before the timeline runs out, but not too rarely
+  time_t due = until - SECONDS_PER_HOUR;
+  time_t longest = time(NULL) + (WEATHER_FORECAST_INTERVAL * SECONDS_PER_MINUTE);
+  if(due > longest) {
+    due = longest;
+  }
+  if(due > s_next_due) {
+    s_next_due = due;
+  }
+}
+
+
+WeatherSchedulerStats weather_scheduler_get_stats() {
+  return s_stats;
+}
@@ -0,0 +1,39 @@
+// When to ask the phone for weather. The watchface reports triggers and
+// the outcome of each request, the scheduler sends the requests itself
+// and keeps the counts that weather_scheduler_get_stats returns.
+
+#include <pebble.h>
+#pragma once
+
+/////////////////////////////
+// weather refresh timings //
+/////////////////////////////
+#define WEATHER_INTERVAL_MIN 30 // minutes between refreshes while weather changes
+#define WEATHER_INTERVAL_MAX 120 // longest stretch while readings stay the same
+#define WEATHER_COALESCE_MS 2000 // triggers this close together share one request
+#define WEATHER_LAUNCH_MS 3000 // give PebbleKit JS time to start before asking
+#define WEATHER_RETRY_MS 5000 // first retry after a failure, doubles each time
+#define WEATHER_RETRY_MAX_MS (10 * 60 * 1000)
+#define WEATHER_FORECAST_INTERVAL 180 // minutes between refreshes while a forecast covers us
+
+typedef enum WeatherTrigger {
+  WEATHER_TRIGGER_TICK, // minute tick, only asks when a refresh is due
+  WEATHER_TRIGGER_RECONNECT, // phone came back, asks if a refresh was missed
+  WEATHER_TRIGGER_CONFIG, // settings changed, asks if a refresh was missed
+  WEATHER_TRIGGER_LAUNCH, // watchface started, asks if the saved reading is stale
+} WeatherTrigger;
+
+typedef struct WeatherSchedulerStats {
+  uint32_t sent;
+  uint32_t suppressed; // triggers that did not go out, disconnected or coalesced
+  uint32_t failed;
+} WeatherSchedulerStats;
+
+void weather_scheduler_init(time_t last_update);
+void weather_scheduler_deinit();
+void weather_scheduler_trigger(WeatherTrigger trigger);
+void weather_scheduler_sent();
+void weather_scheduler_failed();
+void weather_scheduler_received(bool changed);
+void weather_scheduler_covered_until(time_t until);
+WeatherSchedulerStats weather_scheduler_get_stats();
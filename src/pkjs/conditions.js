@@ -0,0 +1,35 @@
+// Maps weather provider icon codes to the condition values the watch
+// understands. The table lives in conditions.json, which the wscript also
+// turns into the WeatherCondition enum on the C side, so adding a provider
+// or a code only means editing that file.
+var spec = require('./conditions.json');
+
+var UNKNOWN = 0;
+
+// provider -> code -> condition value
+var codes = {};
+spec.conditions.forEach(function (condition, value) {
+  Object.keys(condition).forEach(function (provider) {
+    if (provider === 'name' || provider === 'icon') {
+      return;
+    }
+    codes[provider] = codes[provider] || {};
+    condition[provider].forEach(function (code) {
+      codes[provider][code] = value;
+    });
+  });
+});
+
+function fromProvider(provider, code) {
+  var table = codes[provider];
+  if (table && table.hasOwnProperty(code)) {
+    return table[code];
+  }
+  console.log("Unknown " + provider + " condition " + code);
+  return UNKNOWN;
+}
+
+module.exports = {
+  UNKNOWN: UNKNOWN,
+  fromProvider: fromProvider
+};
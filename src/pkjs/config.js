@@ -19,6 +19,21 @@ module.exports = [
 			}
 		]
 	},
+	{
+		"type": "section",
+		"items": [
+			{
+				"type": "heading",
+				"defaultValue": "Weather"
+			},
+			{
+				"type": "toggle",
+				"messageKey": "KEY_TEMP_UNIT",
+				"label": "Show Celsius",
+				"defaultValue": false
+			}
+		]
+	},
 	{
 		"type": "submit",
 		"defaultValue": "Apply Settings"
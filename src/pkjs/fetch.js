@@ -0,0 +1,119 @@
+// Asynchronous JSON fetching with a response cache, request timeouts and
+// sharing of identical requests that overlap. Nothing in here touches the
+// Pebble globals, so it runs the same against a local mock HTTP server.
+//
+// options:
+//   XMLHttpRequest  constructor to use
+//   storage         localStorage-like object for the cache
+//   timeout         ms before a request is abandoned
+//   ttl             ms a cached response stays good
+function createFetcher(options) {
+  var XHR = options.XMLHttpRequest;
+  var storage = options.storage;
+  var timeout = options.timeout || 15000;
+  var ttl = options.ttl || 0;
+
+  // url -> callbacks waiting on the request already going
+  var inFlight = {};
+
+  function readCache(cacheKey) {
+    if (!cacheKey || !storage) {
+      return null;
+    }
+    try {
+      var entry = JSON.parse(storage.getItem(cacheKey));
+      if (entry && Date.now() - entry.at < ttl) {
+        return entry.json;
+      }
+    } catch (err) {
+      storage.removeItem(cacheKey);
+    }
+    return null;
+  }
+
+  function writeCache(cacheKey, json) {
+    if (cacheKey && storage) {
+      storage.setItem(cacheKey, JSON.stringify({ at: Date.now(), json: json }));
+    }
+  }
+
+  function finish(url, err, json) {
+    var callbacks = inFlight[url] || [];
+    delete inFlight[url];
+    callbacks.forEach(function (callback) {
+      callback(err, json);
+    });
+  }
+
+  // callback(err, json), cacheKey may be null to skip the cache
+  function getJson(url, cacheKey, callback) {
+    var cached = readCache(cacheKey);
+    if (cached) {
+      setTimeout(function () {
+        callback(null, cached, true);
+      }, 0);
+      return;
+    }
+
+    if (inFlight[url]) {
+      inFlight[url].push(callback);
+      return;
+    }
+    inFlight[url] = [callback];
+
+    var done = false;
+    var xhr = new XHR();
+    var timer = setTimeout(function () {
+      if (done) {
+        return;
+      }
+      done = true;
+      xhr.abort();
+      finish(url, new Error('timeout after ' + timeout + 'ms'));
+    }, timeout);
+
+    xhr.onload = function () {
+      if (done) {
+        return;
+      }
+      done = true;
+      clearTimeout(timer);
+
+      if (xhr.status !== 200) {
+        var error = new Error('HTTP ' + xhr.status);
+        error.status = xhr.status;
+        finish(url, error);
+        return;
+      }
+      var json;
+      try {
+        json = JSON.parse(xhr.responseText);
+      } catch (err) {
+        finish(url, new Error('bad JSON: ' + err.message));
+        return;
+      }
+      writeCache(cacheKey, json);
+      finish(url, null, json);
+    };
+
+    xhr.onerror = function () {
+      if (done) {
+        return;
+      }
+      done = true;
+      clearTimeout(timer);
+      finish(url, new Error('network error'));
+    };
+
+    xhr.open('GET', url, true);
+    xhr.send();
+  }
+
+  return {
+    getJson: getJson
+  };
+}
+
+module.exports = {
+  createFetcher: createFetcher
+};
@@ -1,100 +1,129 @@
 var Clay = require('pebble-clay');
 var clayConfig = require('./config');
 var clay = new Clay(clayConfig);
+var protocol = require('./protocol');
+var fetch = require('./fetch');
+var geo = require('./location');
+var weather = require('./weather');
+var openWeatherMap = require('./providers/openweathermap');
+var darkSky = require('./providers/darksky');
 
 var myAPIKey = '';
+var darkSkyAPIKey = '';
 
-var xhrRequest = function (url, type, callback) {
-  var xhr = new XMLHttpRequest();
-  xhr.onload = function () {
-    callback(this.responseText);
-  };
-  xhr.open(type, url, false);
-  xhr.send();
-};
-
-// function locationSuccess(pos) {
-//   // Construct URL
-//   var weatherUrl = 'https://api.darksky.net/forecast/' + myAPIKey + '/' + pos.coords.latitude + ',' + pos.coords.longitude;
-  
-//   // get forecast through dark sky
-//   xhrRequest(weatherUrl, 'GET', 
-//     function(responseText) {
-//       var json = JSON.parse(responseText);
-      
-//       // round temperature
-//       var temp = Math.round(json.currently.temperature);
-//       console.log("Temperature is " + temp);
-      
-//       // icon for weather condition
-//       var icon = json.currently.icon;
-//       console.log("Current icon is " + icon);
-      
-//       // assemble dictionary using keys
-//       var dictionary = {
-//         "KEY_TEMP": temp,
-//         "KEY_ICON": icon,
-//       };
-      
-//       // Send to Pebble
-//       Pebble.sendAppMessage(dictionary,
-//         function(e) {
-//           console.log("Weather info sent to Pebble successfully!");
-//         },
-//         function(e) {
-//           console.log("Error sending weather info to Pebble!");
-//         }
-//       );
-//     }      
-//   );
-// }
+// the watch keeps the last reading, no need to fetch at launch if it is this new
+var FRESH_MS = 30 * 60 * 1000;
 
-function locationSuccess(pos) {
-  // Construct URL
-  var weatherUrl = "http://api.openweathermap.org/data/2.5/weather?lat=" +
-      pos.coords.latitude + "&lon=" + pos.coords.longitude + '&appid=' + myAPIKey + '&units=imperial';  
-
-  // Send request to OpenWeatherMap.org
-  xhrRequest(weatherUrl, 'GET', 
-    function(responseText) {
-      var json = JSON.parse(responseText);
-            
-      // Delivered in imperial so no need for adjustment
-      var temp = Math.round(json.main.temp);
-      console.log("Temperature is " + temp);   
-      
-      var icon = json.weather[0].icon;
-      console.log("Icon is " + icon);
-      
-      // assemble dictionary using keys
-      var dictionary = {
-        "KEY_TEMP": temp,
-        "KEY_ICON": icon,
-      };
-
-      // Send to Pebble
-      Pebble.sendAppMessage(dictionary,
-        function(e) {
-          console.log("Weather info sent to Pebble successfully!");
-        },
-        function(e) {
-          console.log("Error sending weather info to Pebble!");
-        }
-      );
-    }      
+// responses are reused for a while, keyed by position rounded to ~1km
+var fetcher = fetch.createFetcher({
+  XMLHttpRequest: XMLHttpRequest,
+  storage: localStorage,
+  timeout: 15000,
+  ttl: 15 * 60 * 1000
+});
+
+// skip location fixes while the phone has not gone far
+var locator = geo.createLocator({
+  geolocation: navigator.geolocation,
+  storage: localStorage,
+  maxDistanceKm: 1,
+  maxAgeMs: 60 * 60 * 1000
+});
+
+// providers in order of preference, the backend moves on to the next
+// one when a provider runs out of its daily budget or keeps failing
+var providers = [
+  openWeatherMap({
+    apiKey: myAPIKey,
+    dailyBudget: 500,
+    forecastEntries: protocol.FORECAST_MAX_ENTRIES
+  })
+];
+if (darkSkyAPIKey) {
+  providers.push(darkSky({
+    apiKey: darkSkyAPIKey,
+    dailyBudget: 500,
+    forecastEntries: protocol.FORECAST_MAX_ENTRIES
+  }));
+}
+
+var backend = weather.createBackend({
+  providers: providers,
+  fetcher: fetcher,
+  storage: localStorage,
+  errorThreshold: 3,
+  cooldownMs: 30 * 60 * 1000
+});
+
+// a fetch is going, later triggers wait for it instead of starting another
+var fetching = false;
+
+function sendWeather(dictionary) {
+  fetching = false;
+  Pebble.sendAppMessage(dictionary,
+    function(e) {
+      console.log("Weather info sent to Pebble successfully!");
+      localStorage.setItem('weatherSentAt', Date.now());
+    },
+    function(e) {
+      console.log("Error sending weather info to Pebble!");
+    }
   );
 }
 
+function locationSuccess(pos) {
+  backend.getWeather(pos, function(err, reading, provider) {
+    if (err) {
+      console.log("Error getting weather: " + err.message);
+      fetching = false;
+      return;
+    }
+    console.log("Temperature is " + Math.round(reading.tempF) + " from " + provider);
+    console.log("Condition is " + reading.condition);
+
+    // assemble dictionary using keys
+    // everything goes packed in one byte array, see protocol.js
+    var dictionary = {
+      "KEY_WEATHER": protocol.encodeWeather({
+        tempF: reading.tempF,
+        tempC: reading.tempC,
+        condition: reading.condition,
+        observed: reading.observed,
+        flags: reading.cached ? protocol.FLAG_CACHED : 0
+      })
+    };
+
+    // forecast goes in the same message, the watch plays it back
+    // on its own so it only needs to ask again every few hours
+    if (reading.forecast) {
+      console.log("Forecast has " + reading.forecast.entries.length + " entries");
+      dictionary.KEY_FORECAST = protocol.encodeForecast(reading.forecast);
+    }
+
+    // Send to Pebble
+    sendWeather(dictionary);
+  });
+}
+
 function locationError(err) {
   console.log("Error requesting location!");
+  fetching = false;
 }
 
 function getWeather() {
-  navigator.geolocation.getCurrentPosition(
-    locationSuccess,
-    locationError,
-    {timeout: 15000, maximumAge: 60000}
-  );
+  if (fetching) {
+    console.log("Weather fetch already running");
+    return;
+  }
+  fetching = true;
+
+  locator.locate(function(err, pos) {
+    if (err) {
+      locationError(err);
+      return;
+    }
+    locationSuccess(pos);
+  });
 }
 
 // Listen for when the watchface is opened
@@ -102,15 +131,28 @@ Pebble.addEventListener('ready',
   function(e) {
     console.log("PebbleKit JS ready!");
 
-    // Get the initial weather
+    // Get the initial weather, unless the watch already has a fresh one
+    // saved. It asks by itself when its copy is stale.
+    var sentAt = parseInt(localStorage.getItem('weatherSentAt'), 10) || 0;
+    if (Date.now() - sentAt < FRESH_MS) {
+      console.log("Watch weather is fresh, skipping startup fetch");
+      return;
+    }
     getWeather();
   }
 );
 
 // Listen for when an AppMessage is received
+// only weather requests from the watch start a fetch
 Pebble.addEventListener('appmessage',
   function(e) {
     console.log("AppMessage received!");
-    getWeather();
+    if (e.payload.KEY_REQUEST_WEATHER !== undefined) {
+      getWeather();
+    }
+    // stats dump from a PERF_STATS build, see src/c/perf.c
+    if (e.payload.KEY_PERF_STATS !== undefined) {
+      console.log("Watch perf stats:\n" + e.payload.KEY_PERF_STATS);
+    }
   }                     
 );
\ No newline at end of file
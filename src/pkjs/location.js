@@ -0,0 +1,101 @@
+// Finds where the phone is without paying for a fresh fix every time.
+// The last fix is kept in storage. Inside maxAgeMs it is reused as is,
+// after that a cheap low-accuracy fix is tried before a high-accuracy
+// one, and a new fix closer than maxDistanceKm to the last one keeps the
+// old coordinates so cached weather for them is reused.
+//
+// options:
+//   geolocation    navigator.geolocation-like object
+//   storage        localStorage-like object
+//   maxDistanceKm  movement that still counts as the same place
+//   maxAgeMs       how long a fix is trusted without asking again
+var STORAGE_KEY = 'lastLocation';
+
+function distanceKm(a, b) {
+  var rad = Math.PI / 180;
+  var dLat = (b.latitude - a.latitude) * rad;
+  var dLon = (b.longitude - a.longitude) * rad;
+  var h = Math.sin(dLat / 2) * Math.sin(dLat / 2) +
+          Math.cos(a.latitude * rad) * Math.cos(b.latitude * rad) *
+          Math.sin(dLon / 2) * Math.sin(dLon / 2);
+  return 6371 * 2 * Math.atan2(Math.sqrt(h), Math.sqrt(1 - h));
+}
+
+function createLocator(options) {
+  var geolocation = options.geolocation;
+  var storage = options.storage;
+  var maxDistanceKm = options.maxDistanceKm;
+  var maxAgeMs = options.maxAgeMs;
+
+  function readLast() {
+    try {
+      return JSON.parse(storage.getItem(STORAGE_KEY));
+    } catch (err) {
+      return null;
+    }
+  }
+
+  function writeLast(coords) {
+    storage.setItem(STORAGE_KEY, JSON.stringify({
+      at: Date.now(),
+      coords: { latitude: coords.latitude, longitude: coords.longitude }
+    }));
+  }
+
+  function requestFix(highAccuracy, callback) {
+    geolocation.getCurrentPosition(
+      function (pos) {
+        callback(null, pos.coords);
+      },
+      function (err) {
+        callback(err || new Error('no fix'));
+      },
+      {
+        enableHighAccuracy: highAccuracy,
+        timeout: highAccuracy ? 30000 : 15000,
+        maximumAge: maxAgeMs
+      }
+    );
+  }
+
+  // callback(err, pos) with pos shaped like a Geolocation position
+  function locate(callback) {
+    var last = readLast();
+    if (last && last.coords && Date.now() - last.at < maxAgeMs) {
+      console.log("Reusing location from " + Math.round((Date.now() - last.at) / 60000) + " min ago");
+      callback(null, { coords: last.coords });
+      return;
+    }
+
+    function useFix(err, coords) {
+      if (err) {
+        callback(err);
+        return;
+      }
+      // barely moved, stay on the old spot so cached weather still matches
+      if (last && last.coords && distanceKm(last.coords, coords) < maxDistanceKm) {
+        coords = last.coords;
+      }
+      writeLast(coords);
+      callback(null, { coords: coords });
+    }
+
+    requestFix(false, function (err, coords) {
+      if (!err) {
+        useFix(null, coords);
+        return;
+      }
+      console.log("Low accuracy location failed, trying high accuracy");
+      requestFix(true, useFix);
+    });
+  }
+
+  return {
+    locate: locate
+  };
+}
+
+module.exports = {
+  createLocator: createLocator,
+  distanceKm: distanceKm
+};
@@ -0,0 +1,55 @@
+// Packs weather into the byte layouts of WeatherPayload and ForecastPayload
+// in src/c/watchface.h. Bump the matching version whenever a struct changes,
+// the watch drops versions it does not know.
+var VERSION = 1;
+var FORECAST_VERSION = 1;
+var FORECAST_MAX_ENTRIES = 24;
+
+var FLAG_CACHED = 1 << 0;
+
+function pushInt16(bytes, value) {
+  value = Math.max(-32768, Math.min(32767, Math.round(value)));
+  bytes.push(value & 0xff, (value >> 8) & 0xff);
+}
+
+function pushUint32(bytes, value) {
+  value = Math.max(0, Math.floor(value)) >>> 0;
+  bytes.push(value & 0xff, (value >>> 8) & 0xff, (value >>> 16) & 0xff, (value >>> 24) & 0xff);
+}
+
+// weather: { tempF, tempC, condition, observed (unix seconds), flags }
+function encodeWeather(weather) {
+  var bytes = [VERSION, (weather.flags || 0) & 0xff, weather.condition & 0xff];
+  pushInt16(bytes, weather.tempF);
+  pushInt16(bytes, weather.tempC);
+  pushUint32(bytes, weather.observed || Date.now() / 1000);
+  return bytes;
+}
+
+function pushUint16(bytes, value) {
+  value = Math.max(0, Math.min(65535, Math.round(value)));
+  bytes.push(value & 0xff, (value >> 8) & 0xff);
+}
+
+// forecast: { start (unix seconds), step (minutes), entries: [{ tempF, tempC, condition }] }
+function encodeForecast(forecast) {
+  var entries = forecast.entries.slice(0, FORECAST_MAX_ENTRIES);
+  var bytes = [FORECAST_VERSION, entries.length];
+  pushUint16(bytes, forecast.step);
+  pushUint32(bytes, forecast.start);
+  entries.forEach(function (entry) {
+    bytes.push(entry.condition & 0xff);
+    pushInt16(bytes, entry.tempF);
+    pushInt16(bytes, entry.tempC);
+  });
+  return bytes;
+}
+
+module.exports = {
+  VERSION: VERSION,
+  FORECAST_VERSION: FORECAST_VERSION,
+  FORECAST_MAX_ENTRIES: FORECAST_MAX_ENTRIES,
+  FLAG_CACHED: FLAG_CACHED,
+  encodeWeather: encodeWeather,
+  encodeForecast: encodeForecast
+};
@@ -0,0 +1,60 @@
+// DarkSky.net, current conditions and the hourly forecast in one request.
+// https://darksky.net/dev/docs/response#data-point
+var conditions = require('../conditions');
+
+function toCelsius(tempF) {
+  return (tempF - 32) * 5 / 9;
+}
+
+// options: apiKey, baseUrl, dailyBudget, forecastEntries
+module.exports = function createDarkSky(options) {
+  var baseUrl = options.baseUrl || 'https://api.darksky.net/forecast/';
+
+  return {
+    name: 'darksky',
+    dailyBudget: options.dailyBudget,
+    requestsPerFetch: 1,
+
+    fetch: function (pos, get, callback) {
+      var url = baseUrl + options.apiKey + '/' + pos.coords.latitude + ',' + pos.coords.longitude +
+                '?exclude=minutely,daily,alerts,flags';
+
+      get(url, 'forecast', function (err, json, cached) {
+        var weather;
+        try {
+          if (err) {
+            throw err;
+          }
+          // temperature in fahrenheit
+          weather = {
+            tempF: json.currently.temperature,
+            tempC: toCelsius(json.currently.temperature),
+            condition: conditions.fromProvider('darksky', json.currently.icon),
+            observed: json.currently.time,
+            cached: cached,
+            forecast: null
+          };
+
+          var hours = ((json.hourly && json.hourly.data) || []).slice(0, options.forecastEntries);
+          if (hours.length >= 2) {
+            weather.forecast = {
+              start: hours[0].time,
+              step: (hours[1].time - hours[0].time) / 60,
+              entries: hours.map(function (hour) {
+                return {
+                  tempF: hour.temperature,
+                  tempC: toCelsius(hour.temperature),
+                  condition: conditions.fromProvider('darksky', hour.icon)
+                };
+              })
+            };
+          }
+        } catch (e) {
+          callback(e);
+          return;
+        }
+        callback(null, weather);
+      });
+    }
+  };
+};
@@ -0,0 +1,76 @@
+// OpenWeatherMap.org, current conditions plus the 3-hourly forecast.
+// https://openweathermap.org/weather-conditions
+var conditions = require('../conditions');
+
+function toCelsius(tempF) {
+  return (tempF - 32) * 5 / 9;
+}
+
+function parseForecast(json, maxEntries) {
+  var list = (json.list || []).slice(0, maxEntries);
+  if (list.length < 2) {
+    return null;
+  }
+  return {
+    start: list[0].dt,
+    step: (list[1].dt - list[0].dt) / 60,
+    entries: list.map(function (item) {
+      return {
+        tempF: item.main.temp,
+        tempC: toCelsius(item.main.temp),
+        condition: conditions.fromProvider('openweathermap', item.weather[0].icon)
+      };
+    })
+  };
+}
+
+// options: apiKey, baseUrl, dailyBudget, forecastEntries
+module.exports = function createOpenWeatherMap(options) {
+  var baseUrl = options.baseUrl || 'http://api.openweathermap.org/data/2.5/';
+
+  return {
+    name: 'openweathermap',
+    dailyBudget: options.dailyBudget,
+    requestsPerFetch: 2,
+
+    // get(url, kind, callback) is handed in by the backend, it caches and counts
+    fetch: function (pos, get, callback) {
+      // Delivered in imperial, celsius worked out here
+      var query = '?lat=' + pos.coords.latitude + '&lon=' + pos.coords.longitude +
+                  '&appid=' + options.apiKey + '&units=imperial';
+
+      get(baseUrl + 'weather' + query, 'weather', function (err, json, cached) {
+        var weather;
+        try {
+          if (err) {
+            throw err;
+          }
+          weather = {
+            tempF: json.main.temp,
+            tempC: toCelsius(json.main.temp),
+            condition: conditions.fromProvider('openweathermap', json.weather[0].icon),
+            observed: json.dt,
+            cached: cached,
+            forecast: null
+          };
+        } catch (e) {
+          callback(e);
+          return;
+        }
+
+        // a bad forecast should not hold back current conditions
+        get(baseUrl + 'forecast' + query + '&cnt=' + options.forecastEntries, 'forecast', function (err, json) {
+          try {
+            if (err) {
+              throw err;
+            }
+            weather.forecast = parseForecast(json, options.forecastEntries);
+          } catch (e) {
+            console.log("Error getting forecast: " + e.message);
+          }
+          callback(null, weather);
+        });
+      });
+    }
+  };
+};
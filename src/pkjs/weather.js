@@ -0,0 +1,126 @@
+// Weather backend that tries providers in order. Each provider has a
+// daily request budget tracked in storage. A provider that answers 429
+// is skipped for the rest of the day, one that keeps failing is skipped
+// for cooldownMs, and the next one is used instead. All providers return
+// the same normalized reading, so the watch never knows which one
+// answered.
+//
+// options:
+//   providers       list from ./providers, in order of preference
+//   fetcher         from fetch.createFetcher
+//   storage         localStorage-like object
+//   errorThreshold  failures in a row before a provider is rested
+//   cooldownMs      how long a failing provider is rested
+var STORAGE_KEY = 'providerState';
+
+function today() {
+  var now = new Date();
+  return now.getFullYear() + '-' + (now.getMonth() + 1) + '-' + now.getDate();
+}
+
+function endOfDay() {
+  var end = new Date();
+  end.setHours(24, 0, 0, 0);
+  return end.getTime();
+}
+
+function cacheKey(provider, kind, pos) {
+  return provider + ':' + kind + ':' + pos.coords.latitude.toFixed(2) + ',' + pos.coords.longitude.toFixed(2);
+}
+
+function createBackend(options) {
+  var providers = options.providers;
+  var fetcher = options.fetcher;
+  var storage = options.storage;
+  var errorThreshold = options.errorThreshold || 3;
+  var cooldownMs = options.cooldownMs || 30 * 60 * 1000;
+
+  function loadState() {
+    var state;
+    try {
+      state = JSON.parse(storage.getItem(STORAGE_KEY)) || {};
+    } catch (err) {
+      state = {};
+    }
+    providers.forEach(function (provider) {
+      var entry = state[provider.name];
+      if (!entry || entry.day !== today()) {
+        state[provider.name] = { day: today(), used: 0, errors: entry ? entry.errors : 0,
+                                 restUntil: entry ? entry.restUntil : 0 };
+      }
+    });
+    return state;
+  }
+
+  function saveState(state) {
+    storage.setItem(STORAGE_KEY, JSON.stringify(state));
+  }
+
+  function available(provider, state) {
+    var entry = state[provider.name];
+    if (Date.now() < entry.restUntil) {
+      return false;
+    }
+    return !provider.dailyBudget || entry.used + provider.requestsPerFetch <= provider.dailyBudget;
+  }
+
+  // callback(err, weather, providerName)
+  function getWeather(pos, callback) {
+    var state = loadState();
+
+    function tryProvider(index) {
+      if (index >= providers.length) {
+        callback(new Error('no weather provider available'));
+        return;
+      }
+      var provider = providers[index];
+      if (!available(provider, state)) {
+        console.log("Skipping " + provider.name + ", used " + state[provider.name].used + " today");
+        tryProvider(index + 1);
+        return;
+      }
+
+      var entry = state[provider.name];
+
+      // network requests count against the budget, cache hits do not
+      function get(url, kind, done) {
+        fetcher.getJson(url, cacheKey(provider.name, kind, pos), function (err, json, cached) {
+          if (!cached) {
+            entry.used++;
+            saveState(state);
+          }
+          done(err, json, cached);
+        });
+      }
+
+      provider.fetch(pos, get, function (err, weather) {
+        if (err) {
+          entry.errors++;
+          if (err.status === 429) {
+            // out of quota, try again tomorrow
+            entry.restUntil = endOfDay();
+          } else if (entry.errors >= errorThreshold) {
+            entry.restUntil = Date.now() + cooldownMs;
+          }
+          saveState(state);
+          console.log(provider.name + " failed: " + err.message + ", trying next provider");
+          tryProvider(index + 1);
+          return;
+        }
+        entry.errors = 0;
+        saveState(state);
+        callback(null, weather, provider.name);
+      });
+    }
+
+    tryProvider(0);
+  }
+
+  return {
+    getWeather: getWeather
+  };
+}
+
+module.exports = {
+  createBackend: createBackend
+};
@@ -0,0 +1,29 @@
+#
+# Builds weather_conditions.h from src/pkjs/conditions.json. Used by the
+# wscript for the watch and by tools/host/gen_headers.py for the host
+# harness, so both compile the same table.
+#
+
+
+def header(spec):
+    # The weather condition enum and its icon table are generated from the
+    # same spec the JS side uses to map provider codes.
+    lines = ['// Generated from src/pkjs/conditions.json, do not edit.',
+             '#include <pebble.h>',
+             '#pragma once',
+             '',
+             'typedef enum WeatherCondition {']
+    for value, condition in enumerate(spec['conditions']):
+        lines.append('  WEATHER_CONDITION_{} = {},'.format(condition['name'], value))
+    lines += ['  WEATHER_CONDITION_COUNT',
+              '} WeatherCondition;',
+              '',
+              '// icon for each condition, recolored at runtime',
+              'static const uint32_t WEATHER_CONDITION_ICONS[WEATHER_CONDITION_COUNT] = {']
+    for condition in spec['conditions']:
+        if condition['icon']:
+            lines.append('  RESOURCE_ID_{}_ICON,'.format(condition['icon']))
+        else:
+            lines.append('  0,')
+    lines += ['};', '']
+    return '\n'.join(lines)
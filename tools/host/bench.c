@@ -0,0 +1,288 @@
+// Render benchmark for the watchface on the host. Moves the hands
+// through all 720 positions of a 12 hour dial and calls each update
+// proc the way the layer tree would, then reports per proc timing and
+// what it drew: draw calls, stroke pixels, fill calls and pixels, and
+// blitted and text pixels. A second pass runs the real tick_handler and
+// renders whole frames through the mock layer tree.
+//
+// The draw counters do not depend on the machine, so they are kept per
+// platform in baseline/ and any that grew is reported as a regression.
+// Timings vary from run to run and are only printed.
+//
+// usage: bench [--counts] [--check FILE | --update FILE] [--tolerance PCT]
+//   --counts     leaves out timings, so the output only changes when the
+//                drawing does and can be diffed between builds
+//   --check      compare the counters with FILE, exit 1 if any grew
+//                by more than PCT percent, 0 unless given
+//   --update     write the counters to FILE
+
+
+#include <pebble.h>
+#include "mock.h"
+
+#define main watchface_main
+#include "watchface.c"
+#undef main
+
+
+#define BENCH_START 1704067200 // Monday 1 January 2024, 00:00 UTC
+#define BENCH_POSITIONS (12 * 60)
+#define BENCH_MAX_ROWS 16
+#define BENCH_NAME_SIZE 40
+#define BENCH_COUNTERS 6
+
+typedef struct BenchProc {
+  const char *name;
+  LayerUpdateProc proc;
+  Layer **layer;
+} BenchProc;
+
+typedef struct BenchResult {
+  uint32_t calls;
+  uint64_t ns;
+  uint64_t draw_calls, stroke_pixels, fills, fill_pixels, blit_pixels, text_pixels;
+} BenchResult;
+
+// what one printed row averaged per call, for the baseline
+typedef struct BenchRow {
+  char name[BENCH_NAME_SIZE];
+  double counters[BENCH_COUNTERS];
+} BenchRow;
+
+static const char *const s_counter_names[BENCH_COUNTERS] = {
+  "draws", "stroke px", "fills", "fill px", "blit px", "text px"
+};
+static BenchRow s_rows[BENCH_MAX_ROWS];
+static int s_row_count;
+
+// in the order the layer tree draws them
+static const BenchProc s_procs[] = {
+#if SINGLE_LAYER
+  { "compositor_update_proc", compositor_update_proc, &s_dial_layer },
+#else
+  { "dial_update_proc", dial_update_proc, &s_dial_layer },
+  { "temp_update_proc", temp_update_proc, &s_temp_circle },
+  { "battery_update_proc", battery_update_proc, &s_battery_circle },
+  { "health_update_proc", health_update_proc, &s_health_circle },
+  { "ticks_update_proc", ticks_update_proc, &s_hands_layer },
+#endif
+};
+
+
+/////////////////////////////////////
+// add draw counters to the result //
+/////////////////////////////////////
+static void result_add(BenchResult *result, uint64_t ns) {
+  MockDrawStats stats = mock_draw_stats_take();
+  result->calls++;
+  result->ns += ns;
+  result->draw_calls += stats.draw_calls;
+  result->stroke_pixels += stats.stroke_pixels;
+  result->fills += stats.fills;
+  result->fill_pixels += stats.fill_pixels;
+  result->blit_pixels += stats.blit_pixels;
+  result->text_pixels += stats.text_pixels;
+}
+
+
+/////////////////////////////////////////////////
+// one row, averaged per call, kept for checks //
+/////////////////////////////////////////////////
+static void result_print(const char *section, const char *name, const BenchResult *result, bool counts_only) {
+  double calls = result->calls ? result->calls : 1;
+  BenchRow *row = &s_rows[s_row_count++];
+  snprintf(row->name, sizeof(row->name), "%s/%s", section, name);
+  double counters[BENCH_COUNTERS] = {
+    result->draw_calls / calls, result->stroke_pixels / calls, result->fills / calls,
+    result->fill_pixels / calls, result->blit_pixels / calls, result->text_pixels / calls,
+  };
+  memcpy(row->counters, counters, sizeof(counters));
+
+  printf("%-24s %6u", name, (unsigned)result->calls);
+  if(!counts_only) {
+    printf(" %9.2f", result->ns / calls / 1000.0);
+  }
+  printf(" %7.1f %9.1f %6.1f %9.1f %9.1f %8.1f\n", counters[0], counters[1], counters[2], counters[3],
+         counters[4], counters[5]);
+}
+
+
+static void header_print(const char *title, bool counts_only) {
+  printf("\n%-24s %6s", title, "calls");
+  if(!counts_only) {
+    printf(" %9s", "us/call");
+  }
+  printf(" %7s %9s %6s %9s %9s %8s\n", "draws", "stroke px", "fills", "fill px", "blit px", "text px");
+}
+
+
+//////////////////////////////////
+// every proc at every position //
+//////////////////////////////////
+static void bench_procs(bool counts_only) {
+  BenchResult results[ARRAY_LENGTH(s_procs)] = { 0 };
+  BenchResult first[ARRAY_LENGTH(s_procs)] = { 0 };
+  GContext *ctx = mock_context();
+
+  for(int position=0; position<=BENCH_POSITIONS; position++) {
+    // position 0 is the cold first frame, the dial is not cached yet
+    time_t now = BENCH_START + (position * SECONDS_PER_MINUTE);
+    mock_set_time(now);
+    if(position > 0) {
+      hands_set_time(localtime(&now));
+    }
+
+    mock_draw_stats_take();
+    for(unsigned int i=0; i<ARRAY_LENGTH(s_procs); i++) {
+      uint64_t start = mock_now_ns();
+      s_procs[i].proc(*s_procs[i].layer, ctx);
+      result_add(position > 0 ? &results[i] : &first[i], mock_now_ns() - start);
+    }
+  }
+
+  header_print("first frame", counts_only);
+  for(unsigned int i=0; i<ARRAY_LENGTH(s_procs); i++) {
+    result_print("first", s_procs[i].name, &first[i], counts_only);
+  }
+  header_print("each minute", counts_only);
+  for(unsigned int i=0; i<ARRAY_LENGTH(s_procs); i++) {
+    result_print("minute", s_procs[i].name, &results[i], counts_only);
+  }
+}
+
+
+/////////////////////////////////////////////
+// tick_handler and whole frames, 12 hours //
+/////////////////////////////////////////////
+static void bench_frames(bool counts_only) {
+  BenchResult frames = { 0 };
+
+  for(int position=1; position<=BENCH_POSITIONS; position++) {
+    time_t now = BENCH_START + (position * SECONDS_PER_MINUTE);
+    mock_set_time(now);
+    struct tm *tick_time = localtime(&now);
+    tick_handler(tick_time, MINUTE_UNIT | (tick_time->tm_min == 0 ? HOUR_UNIT : 0));
+
+    mock_draw_stats_take();
+    uint64_t start = mock_now_ns();
+    mock_render();
+    result_add(&frames, mock_now_ns() - start);
+  }
+
+  header_print("layer tree", counts_only);
+  result_print("tree", "frame", &frames, counts_only);
+}
+
+
+//////////////////////////////////////
+// counters saved for a row, if any //
+//////////////////////////////////////
+static bool baseline_find(FILE *file, const char *name, double counters[BENCH_COUNTERS]) {
+  char line[256], line_name[BENCH_NAME_SIZE];
+  double values[BENCH_COUNTERS];
+  rewind(file);
+  while(fgets(line, sizeof(line), file)) {
+    if(line[0] != '#' && sscanf(line, "%39s %lf %lf %lf %lf %lf %lf", line_name, &values[0], &values[1], &values[2],
+                                &values[3], &values[4], &values[5]) == 1 + BENCH_COUNTERS &&
+       strcmp(line_name, name) == 0) {
+      memcpy(counters, values, sizeof(values));
+      return true;
+    }
+  }
+  return false;
+}
+
+
+////////////////////////////////////////////////////
+// counters that grew past the baseline, how many //
+////////////////////////////////////////////////////
+static int baseline_check(FILE *file, double tolerance) {
+  int regressions = 0;
+  printf("\n");
+  for(int i=0; i<s_row_count; i++) {
+    const BenchRow *row = &s_rows[i];
+    double expected[BENCH_COUNTERS];
+    if(!baseline_find(file, row->name, expected)) {
+      printf("%-32s not in the baseline\n", row->name);
+      regressions++;
+      continue;
+    }
+    for(int c=0; c<BENCH_COUNTERS; c++) {
+      // the file has one decimal, so allow for its rounding
+      double limit = expected[c] * (1 + tolerance / 100) + 0.05;
+      if(row->counters[c] > limit) {
+        printf("%-32s %-9s %9.1f -> %9.1f REGRESSED\n", row->name, s_counter_names[c], expected[c],
+               row->counters[c]);
+        regressions++;
+      } else if(row->counters[c] < expected[c] - 0.05) {
+        printf("%-32s %-9s %9.1f -> %9.1f lower, update the baseline\n", row->name, s_counter_names[c],
+               expected[c], row->counters[c]);
+      }
+    }
+  }
+  if(regressions) {
+    printf("%d counters over the baseline, tolerance %.1f%%\n", regressions, tolerance);
+  }
+  return regressions;
+}
+
+
+int main(int argc, char **argv) {
+  bool counts_only = false;
+  const char *check_path = NULL, *update_path = NULL;
+  double tolerance = 0;
+  for(int i=1; i<argc; i++) {
+    if(strcmp(argv[i], "--counts") == 0) {
+      counts_only = true;
+    } else if(strcmp(argv[i], "--check") == 0 && i + 1 < argc) {
+      check_path = argv[++i];
+    } else if(strcmp(argv[i], "--update") == 0 && i + 1 < argc) {
+      update_path = argv[++i];
+    } else if(strcmp(argv[i], "--tolerance") == 0 && i + 1 < argc) {
+      tolerance = atof(argv[++i]);
+    } else {
+      fprintf(stderr, "usage: bench [--counts] [--check FILE | --update FILE] [--tolerance PCT]\n");
+      return 2;
+    }
+  }
+
+  FILE *check = NULL, *update = NULL;
+  if(check_path && !(check = fopen(check_path, "r"))) {
+    perror(check_path);
+    return 2;
+  }
+  if(update_path && !(update = fopen(update_path, "w"))) {
+    perror(update_path);
+    return 2;
+  }
+
+  mock_init(BENCH_START);
+  init();
+
+  printf("%s %dx%d, %d positions, PARTIAL_REDRAW %d, SINGLE_LAYER %d\n",
+         PBL_IF_ROUND_ELSE("round", "rect"), PBL_DISPLAY_WIDTH, PBL_DISPLAY_HEIGHT, BENCH_POSITIONS,
+         PARTIAL_REDRAW, SINGLE_LAYER);
+  bench_procs(counts_only);
+  bench_frames(counts_only);
+  deinit();
+
+  int regressions = 0;
+  if(check) {
+    regressions = baseline_check(check, tolerance);
+    fclose(check);
+  }
+  if(update) {
+    fprintf(update, "# %s %dx%d, PARTIAL_REDRAW %d, SINGLE_LAYER %d, written by make bench-update\n",
+            PBL_IF_ROUND_ELSE("round", "rect"), PBL_DISPLAY_WIDTH, PBL_DISPLAY_HEIGHT, PARTIAL_REDRAW, SINGLE_LAYER);
+    fprintf(update, "# per call: draws, stroke px, fills, fill px, blit px, text px\n");
+    for(int i=0; i<s_row_count; i++) {
+      fprintf(update, "%s", s_rows[i].name);
+      for(int c=0; c<BENCH_COUNTERS; c++) {
+        fprintf(update, " %.1f", s_rows[i].counters[c]);
+      }
+      fprintf(update, "\n");
+    }
+    fclose(update);
+  }
+  return regressions ? 1 : 0;
+}
@@ -0,0 +1,153 @@
+#
+# Writes what the Pebble SDK would generate for the watchface into OUT_DIR
+# so src/c builds on the host: resource ids, message keys, the weather
+# condition table, and the icon images decoded from their PNGs. Also the
+# condition names the harness reads and writes in traces.
+#
+# usage: gen_headers.py OUT_DIR
+#
+
+import json
+import os
+import struct
+import sys
+import zlib
+
+ROOT = os.path.abspath(os.path.join(os.path.dirname(__file__), '..', '..'))
+sys.path.insert(0, os.path.join(ROOT, 'tools'))
+import conditions
+
+
+def write(path, text):
+    # leave unchanged files alone so make does not rebuild
+    if os.path.exists(path):
+        with open(path) as f:
+            if f.read() == text:
+                return
+    with open(path, 'w') as f:
+        f.write(text)
+
+
+def png_mask(path):
+    # 8 bit PNGs only, which is what resources/images holds. A pixel is
+    # set where it is opaque and light, the icons are white glyphs.
+    with open(path, 'rb') as f:
+        data = f.read()
+    pos, idat, palette, trns = 8, b'', None, None
+    while pos < len(data):
+        length, kind = struct.unpack('>I4s', data[pos:pos + 8])
+        chunk = data[pos + 8:pos + 8 + length]
+        pos += 12 + length
+        if kind == b'IHDR':
+            width, height, depth, color_type = struct.unpack('>IIBB', chunk[:10])
+        elif kind == b'PLTE':
+            palette = chunk
+        elif kind == b'tRNS':
+            trns = chunk
+        elif kind == b'IDAT':
+            idat += chunk
+    if depth != 8:
+        raise ValueError('{}: {} bit PNG not supported'.format(path, depth))
+    channels = {0: 1, 2: 3, 3: 1, 4: 2, 6: 4}[color_type]
+
+    raw = bytearray(zlib.decompress(idat))
+    stride = width * channels
+    rows, prev = [], bytearray(stride)
+    for y in range(height):
+        start = y * (stride + 1)
+        kind, row = raw[start], bytearray(raw[start + 1:start + 1 + stride])
+        for x in range(stride):
+            a = row[x - channels] if x >= channels else 0
+            b = prev[x]
+            c = prev[x - channels] if x >= channels else 0
+            if kind == 1:
+                row[x] = (row[x] + a) & 0xff
+            elif kind == 2:
+                row[x] = (row[x] + b) & 0xff
+            elif kind == 3:
+                row[x] = (row[x] + ((a + b) // 2)) & 0xff
+            elif kind == 4:
+                p = a + b - c
+                pa, pb, pc = abs(p - a), abs(p - b), abs(p - c)
+                row[x] = (row[x] + (a if pa <= pb and pa <= pc else b if pb <= pc else c)) & 0xff
+        rows.append(row)
+        prev = row
+
+    mask = []
+    for row in rows:
+        for x in range(width):
+            px = row[x * channels:(x + 1) * channels]
+            if color_type == 3:
+                index = px[0]
+                rgb = bytearray(palette[index * 3:index * 3 + 3])
+                alpha = bytearray(trns)[index] if trns and index < len(trns) else 255
+            elif color_type in (0, 4):
+                rgb, alpha = [px[0]] * 3, px[1] if color_type == 4 else 255
+            else:
+                rgb, alpha = px[:3], px[3] if color_type == 6 else 255
+            mask.append(1 if alpha >= 128 and sum(rgb) >= 3 * 128 else 0)
+    return width, height, mask
+
+
+def main(out_dir):
+    with open(os.path.join(ROOT, 'package.json')) as f:
+        pebble = json.load(f)['pebble']
+    with open(os.path.join(ROOT, 'src', 'pkjs', 'conditions.json')) as f:
+        spec = json.load(f)
+    if not os.path.isdir(out_dir):
+        os.makedirs(out_dir)
+
+    # per platform variants share a name, the host only needs one id each
+    names, media = [], {}
+    for entry in pebble['resources']['media']:
+        if entry['name'] not in media:
+            names.append(entry['name'])
+            media[entry['name']] = entry
+
+    lines = ['// Generated by tools/host/gen_headers.py, do not edit.',
+             '#pragma once', '',
+             'typedef enum ResourceId {', '  INVALID_RESOURCE = 0,']
+    for value, name in enumerate(names):
+        lines.append('  RESOURCE_ID_{} = {},'.format(name, value + 1))
+    lines += ['} ResourceId;', '']
+    write(os.path.join(out_dir, 'resource_ids.auto.h'), '\n'.join(lines))
+
+    lines = ['// Generated by tools/host/gen_headers.py, do not edit.', '#pragma once', '']
+    for value, key in enumerate(pebble['messageKeys']):
+        lines.append('#define MESSAGE_KEY_{} {}'.format(key, 10000 + value))
+    lines.append('')
+    write(os.path.join(out_dir, 'message_keys.auto.h'), '\n'.join(lines))
+
+    write(os.path.join(out_dir, 'weather_conditions.h'), conditions.header(spec))
+
+    # the enum names in lower case, "clear_sky_day" for CLEAR_SKY_DAY
+    lines = ['// Generated by tools/host/gen_headers.py, do not edit.',
+             '#pragma once', '#include "weather_conditions.h"', '',
+             'static const char *const WEATHER_CONDITION_NAMES[WEATHER_CONDITION_COUNT] = {']
+    for condition in spec['conditions']:
+        lines.append('  "{}",'.format(condition['name'].lower()))
+    lines += ['};', '']
+    write(os.path.join(out_dir, 'weather_condition_names.h'), '\n'.join(lines))
+
+    lines = ['// Generated by tools/host/gen_headers.py, do not edit.',
+             '#include <pebble.h>', '#include "mock.h"', '']
+    images = [name for name in names if media[name]['type'] == 'bitmap' and name.endswith('_ICON')]
+    decoded = {}
+    for name in images:
+        width, height, mask = decoded[name] = png_mask(os.path.join(ROOT, 'resources', media[name]['file']))
+        lines.append('static const uint8_t s_{}[{}] = {{'.format(name, width * height))
+        for y in range(height):
+            lines.append('  ' + ', '.join(str(v) for v in mask[y * width:(y + 1) * width]) + ',')
+        lines += ['};', '']
+    lines.append('const MockImage mock_images[] = {')
+    for name in images:
+        width, height, _ = decoded[name]
+        lines.append('  {{ RESOURCE_ID_{0}, {1}, {2}, s_{0} }},'.format(name, width, height))
+    lines += ['};', '', 'const int mock_image_count = {};'.format(len(images)), '']
+    write(os.path.join(out_dir, 'resources.auto.c'), '\n'.join(lines))
+
+
+if __name__ == '__main__':
+    if len(sys.argv) != 2:
+        sys.exit('usage: gen_headers.py OUT_DIR')
+    main(sys.argv[1])
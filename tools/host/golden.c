@@ -0,0 +1,364 @@
+// Screenshot regression for the watchface on the host. Launches the face
+// cold in a fixed matrix of states, times of day, battery levels,
+// charging, Bluetooth dropped, step counts, every weather condition, in
+// both polarities, and hashes the frame it renders. The hashes are kept
+// per platform in golden/ and any state whose frame changed is reported.
+//
+// Each state runs in its own forked process, so nothing one launch
+// leaves behind can leak into the next. Also times the first frame and a
+// full redraw after it, which should come out pixel for pixel the same.
+//
+// Tick states launch a minute early and let the tick handler move the
+// hands, which only repaints around them. The frame has to match a cold
+// launch at the same minute, so a dial restore that leaves a trail shows
+// up even while every cold frame is unchanged. They cover a full sweep
+// of the minute hand and every hour of the hour hand, so the hands cross
+// each widget and the date.
+//
+// usage: golden [--check FILE | --update FILE] [--ppm DIR]
+//   --check   compare against FILE, exit 1 if any state differs
+//   --update  write the hashes to FILE
+//   --ppm     write each state's frame to DIR/STATE.ppm for a look
+
+
+#include <pebble.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "mock.h"
+
+#define main watchface_main
+#include "watchface.c"
+#undef main
+
+
+#define GOLDEN_DATE 1704067200 // Monday 1 January 2024, 00:00 UTC
+#define GOLDEN_MAX_STATES 256
+#define GOLDEN_NAME_SIZE 32
+#define HM(h, m) (((h) * 60 + (m)) * 60)
+
+typedef struct GoldenState {
+  char name[GOLDEN_NAME_SIZE];
+  time_t time;
+  uint8_t battery;
+  bool charging;
+  bool plugged;
+  bool connected;
+  HealthValue steps;
+  bool weather; // a saved reading to show at launch
+  WeatherCondition condition;
+  int16_t temp_f;
+  bool celsius;
+  bool inverted;
+  bool tick; // launched a minute before time, then ticked to it
+} GoldenState;
+
+typedef struct GoldenResult {
+  uint32_t hash;
+  uint32_t redraw_hash;
+  uint64_t first_ns;
+  uint64_t redraw_ns;
+} GoldenResult;
+
+static GoldenState s_states[GOLDEN_MAX_STATES];
+static int s_state_count;
+
+
+/////////////////////////////////////////////////
+// a face at 10:08 on a good day, then tweaked //
+/////////////////////////////////////////////////
+static GoldenState *state_add(const char *name) {
+  GoldenState *state = &s_states[s_state_count++];
+  *state = (GoldenState) {
+    .time = GOLDEN_DATE + HM(10, 8),
+    .battery = 80,
+    .connected = true,
+    .steps = 4200,
+    .weather = true,
+    .condition = WEATHER_CONDITION_PARTLY_CLOUDY_DAY,
+    .temp_f = 64,
+  };
+  snprintf(state->name, sizeof(state->name), "%s", name);
+  return state;
+}
+
+
+static void states_build(void) {
+  static const int times[][2] = { { 0, 0 }, { 3, 17 }, { 6, 30 }, { 9, 45 }, { 10, 8 }, { 12, 0 },
+                                  { 15, 52 }, { 18, 30 }, { 21, 11 }, { 23, 59 } };
+  static const uint8_t batteries[] = { 0, 10, 20, 50, 100 };
+  static const HealthValue steps[] = { 0, 999, 8000, 12345, 99999 };
+  char name[GOLDEN_NAME_SIZE];
+
+  for(int inverted=0; inverted<2; inverted++) {
+    const char *polarity = inverted ? "inverted" : "normal";
+    int first = s_state_count;
+
+    for(unsigned int i=0; i<ARRAY_LENGTH(times); i++) {
+      snprintf(name, sizeof(name), "%s/time-%02d%02d", polarity, times[i][0], times[i][1]);
+      state_add(name)->time = GOLDEN_DATE + HM(times[i][0], times[i][1]);
+    }
+    snprintf(name, sizeof(name), "%s/date-0229", polarity);
+    state_add(name)->time = GOLDEN_DATE + (59 * SECONDS_PER_DAY) + HM(10, 8);
+
+    for(unsigned int i=0; i<ARRAY_LENGTH(batteries); i++) {
+      snprintf(name, sizeof(name), "%s/battery-%d", polarity, batteries[i]);
+      state_add(name)->battery = batteries[i];
+    }
+    snprintf(name, sizeof(name), "%s/charging-40", polarity);
+    GoldenState *state = state_add(name);
+    state->battery = 40;
+    state->charging = state->plugged = true;
+    snprintf(name, sizeof(name), "%s/plugged-100", polarity);
+    state = state_add(name);
+    state->battery = 100;
+    state->plugged = true;
+
+    snprintf(name, sizeof(name), "%s/disconnected", polarity);
+    state_add(name)->connected = false;
+
+    for(unsigned int i=0; i<ARRAY_LENGTH(steps); i++) {
+      snprintf(name, sizeof(name), "%s/steps-%d", polarity, (int)steps[i]);
+      state_add(name)->steps = steps[i];
+    }
+
+    for(int condition=0; condition<WEATHER_CONDITION_COUNT; condition++) {
+      snprintf(name, sizeof(name), "%s/weather-%02d", polarity, condition);
+      state_add(name)->condition = condition;
+    }
+    snprintf(name, sizeof(name), "%s/no-weather", polarity);
+    state_add(name)->weather = false;
+    snprintf(name, sizeof(name), "%s/temp-minus-40", polarity);
+    state_add(name)->temp_f = -40;
+    snprintf(name, sizeof(name), "%s/temp-104", polarity);
+    state_add(name)->temp_f = 104;
+    snprintf(name, sizeof(name), "%s/celsius", polarity);
+    state_add(name)->celsius = true;
+
+    for(int i=first; i<s_state_count; i++) {
+      s_states[i].inverted = inverted;
+    }
+  }
+
+  // the minute hand all the way round, then the hour hand
+  for(int minute=0; minute<60; minute++) {
+    snprintf(name, sizeof(name), "tick/10%02d", minute);
+    GoldenState *state = state_add(name);
+    state->time = GOLDEN_DATE + HM(10, minute);
+    state->tick = true;
+  }
+  for(int hour=0; hour<12; hour++) {
+    snprintf(name, sizeof(name), "tick/%02d30", hour);
+    GoldenState *state = state_add(name);
+    state->time = GOLDEN_DATE + HM(hour, 30);
+    state->tick = true;
+  }
+}
+
+
+//////////////////////////////////////
+// directories leading up to a file //
+//////////////////////////////////////
+static void dirs_make(char *path) {
+  for(char *slash = strchr(path + 1, '/'); slash; slash = strchr(slash + 1, '/')) {
+    *slash = '\0';
+    mkdir(path, 0777);
+    *slash = '/';
+  }
+}
+
+
+///////////////////////////////////////////////////
+// launch the face in one state, in this process //
+///////////////////////////////////////////////////
+static GoldenResult state_render(const GoldenState *state, const char *ppm_dir) {
+  mock_init(state->tick ? state->time - SECONDS_PER_MINUTE : state->time);
+  mock_set_battery((BatteryChargeState) {
+    .charge_percent = state->battery,
+    .is_charging = state->charging,
+    .is_plugged = state->plugged,
+  });
+  mock_set_connected(state->connected);
+  mock_set_steps(state->steps);
+
+  // what config_load and weather_load find in flash at launch
+  ClaySettings saved = {
+    .BackgroundColor = state->inverted ? GColorWhite : GColorBlack,
+    .ForegroundColor = state->inverted ? GColorBlack : GColorWhite,
+    .InvertColors = state->inverted,
+    .Celsius = state->celsius,
+  };
+  persist_write_data(SETTINGS_KEY, &saved, sizeof(saved));
+  if(state->weather) {
+    WeatherSnapshot snapshot = {
+      .weather = {
+        .version = WEATHER_PAYLOAD_VERSION,
+        .condition = state->condition,
+        .temp_f = state->temp_f,
+        .temp_c = (state->temp_f - 32) * 5 / 9,
+        .observed = state->time,
+      },
+      .received = state->time,
+    };
+    persist_write_data(WEATHER_KEY, &snapshot, sizeof(snapshot));
+  }
+
+  GoldenResult result = { 0 };
+  init();
+  uint64_t start = mock_now_ns();
+  mock_render();
+  result.first_ns = mock_now_ns() - start;
+  if(state->tick) {
+    mock_set_time(state->time);
+    mock_tick();
+  }
+  result.hash = mock_framebuffer_hash();
+
+  if(ppm_dir) {
+    char path[256];
+    snprintf(path, sizeof(path), "%s/%s.ppm", ppm_dir, state->name);
+    dirs_make(path);
+    if(!mock_framebuffer_write_ppm(path)) {
+      perror(path);
+    }
+  }
+
+  // everything again, on top of the frame already there
+  layer_mark_dirty(window_get_root_layer(s_main_window));
+  start = mock_now_ns();
+  mock_render();
+  result.redraw_ns = mock_now_ns() - start;
+  result.redraw_hash = mock_framebuffer_hash();
+
+  deinit();
+  return result;
+}
+
+
+static bool state_run(const GoldenState *state, const char *ppm_dir, GoldenResult *result) {
+  int fds[2];
+  if(pipe(fds) != 0) {
+    perror("pipe");
+    return false;
+  }
+
+  pid_t pid = fork();
+  if(pid == 0) {
+    close(fds[0]);
+    GoldenResult child = state_render(state, ppm_dir);
+    _exit(write(fds[1], &child, sizeof(child)) == sizeof(child) ? 0 : 1);
+  }
+  close(fds[1]);
+
+  int status = 0;
+  bool ok = pid > 0 && read(fds[0], result, sizeof(*result)) == sizeof(*result);
+  close(fds[0]);
+  if(pid > 0) {
+    waitpid(pid, &status, 0);
+  }
+  return ok && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+
+////////////////////////////////////
+// hash saved for a state, if any //
+////////////////////////////////////
+static bool golden_find(FILE *file, const char *name, uint32_t *hash) {
+  char line[128], line_name[GOLDEN_NAME_SIZE];
+  unsigned int line_hash;
+  rewind(file);
+  while(fgets(line, sizeof(line), file)) {
+    if(line[0] != '#' && sscanf(line, "%31s %x", line_name, &line_hash) == 2 && strcmp(line_name, name) == 0) {
+      *hash = line_hash;
+      return true;
+    }
+  }
+  return false;
+}
+
+
+int main(int argc, char **argv) {
+  const char *check_path = NULL, *update_path = NULL, *ppm_dir = NULL;
+  for(int i=1; i<argc - 1; i+=2) {
+    if(strcmp(argv[i], "--check") == 0) {
+      check_path = argv[i + 1];
+    } else if(strcmp(argv[i], "--update") == 0) {
+      update_path = argv[i + 1];
+    } else if(strcmp(argv[i], "--ppm") == 0) {
+      ppm_dir = argv[i + 1];
+    }
+  }
+  if((argc - 1) % 2) {
+    fprintf(stderr, "usage: golden [--check FILE | --update FILE] [--ppm DIR]\n");
+    return 2;
+  }
+
+  FILE *check = NULL, *update = NULL;
+  if(check_path && !(check = fopen(check_path, "r"))) {
+    perror(check_path);
+    return 2;
+  }
+  if(update_path && !(update = fopen(update_path, "w"))) {
+    perror(update_path);
+    return 2;
+  }
+  if(update) {
+    fprintf(update, "# %s %dx%d, written by make golden-update\n",
+            PBL_IF_ROUND_ELSE("round", "rect"), PBL_DISPLAY_WIDTH, PBL_DISPLAY_HEIGHT);
+  }
+
+  states_build();
+  printf("%s %dx%d, %d states, PARTIAL_REDRAW %d, SINGLE_LAYER %d\n",
+         PBL_IF_ROUND_ELSE("round", "rect"), PBL_DISPLAY_WIDTH, PBL_DISPLAY_HEIGHT, s_state_count,
+         PARTIAL_REDRAW, SINGLE_LAYER);
+  printf("%-28s %8s %-8s %9s %9s\n", "state", "hash", "", "first us", "redraw us");
+
+  int failures = 0;
+  for(int i=0; i<s_state_count; i++) {
+    const GoldenState *state = &s_states[i];
+    GoldenResult result;
+    if(!state_run(state, ppm_dir, &result)) {
+      printf("%-28s %8s %-8s\n", state->name, "", "CRASHED");
+      failures++;
+      continue;
+    }
+
+    // the same minute launched cold
+    GoldenState cold = *state;
+    cold.tick = false;
+    GoldenResult cold_result;
+
+    const char *status = "";
+    uint32_t expected;
+    if(result.redraw_hash != result.hash) {
+      status = "REDRAW";
+      failures++;
+    } else if(state->tick && (!state_run(&cold, NULL, &cold_result) || cold_result.hash != result.hash)) {
+      status = "TICK";
+      failures++;
+    } else if(check && !golden_find(check, state->name, &expected)) {
+      status = "NEW";
+      failures++;
+    } else if(check && expected != result.hash) {
+      status = "CHANGED";
+      failures++;
+    }
+    printf("%-28s %08x %-8s %9.1f %9.1f\n", state->name, (unsigned)result.hash, status,
+           result.first_ns / 1000.0, result.redraw_ns / 1000.0);
+
+    if(update) {
+      fprintf(update, "%s %08x\n", state->name, (unsigned)result.hash);
+    }
+  }
+
+  if(check) {
+    fclose(check);
+  }
+  if(update) {
+    fclose(update);
+  }
+  if(failures) {
+    printf("%d of %d states differ\n", failures, s_state_count);
+  }
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,1732 @@
+// Host implementation of the SDK calls in pebble.h. Drawing goes into an
+// in-memory frame buffer in the platform's own format: 1-bit 144x168 on
+// aplite and diorite, 8-bit 144x168 on basalt and 8-bit 180x180 with a
+// circular mask on chalk. Every draw call and pixel written is counted.
+// Shapes follow the SDK's rules closely enough to compare frames, but
+// antialiasing is ignored and text uses a small block font.
+
+
+#include <math.h>
+#include <stdarg.h>
+#include <pebble.h>
+#include "mock.h"
+
+
+#if defined(PBL_PLATFORM_APLITE)
+#define HEAP_SIZE 24576
+#else
+#define HEAP_SIZE 65536
+#endif
+#define PERSIST_SLOTS 16
+#define PERSIST_DATA_MAX 256
+#define DICT_BUFFER_SIZE 1024
+#define TUPLE_HEADER_SIZE 7
+#define OUTBOX_ACK_MS 200 // phone acknowledges a message this long after it is sent
+
+typedef enum LayerKind {
+  LAYER_PLAIN,
+  LAYER_TEXT,
+  LAYER_BITMAP,
+} LayerKind;
+
+struct GBitmap {
+  uint8_t *data;
+  uint16_t row_size;
+  GBitmapFormat format;
+  GSize size;
+  GRect bounds;
+  GColor *palette;
+};
+
+struct GContext {
+  GBitmap *fb;
+  GPoint offset; // origin of the layer being drawn, in screen coordinates
+  GRect clip; // in screen coordinates
+  GColor stroke_color;
+  GColor fill_color;
+  GColor text_color;
+  GCompOp compositing;
+  uint8_t stroke_width;
+  bool antialiased;
+};
+
+struct Layer {
+  LayerKind kind;
+  GRect frame;
+  GRect bounds;
+  LayerUpdateProc update_proc;
+  Layer *parent;
+  Layer *first_child;
+  Layer *next_sibling;
+  bool hidden;
+};
+
+struct TextLayer {
+  Layer layer; // first, so the Layer can be cast back
+  const char *text;
+  GFont font;
+  GColor text_color;
+  GColor background_color;
+  GTextAlignment alignment;
+};
+
+struct BitmapLayer {
+  Layer layer; // first, so the Layer can be cast back
+  const GBitmap *bitmap;
+  GColor background_color;
+  GCompOp compositing;
+};
+
+struct Window {
+  Layer *root;
+  WindowHandlers handlers;
+  GColor background_color;
+};
+
+struct AppTimer {
+  uint64_t due_ms;
+  AppTimerCallback callback;
+  void *data;
+  AppTimer *next;
+};
+
+struct DictionaryIterator {
+  uint8_t buffer[DICT_BUFFER_SIZE];
+  uint16_t size; // bytes used, count byte included
+};
+
+struct MockFont {
+  uint32_t resource_id;
+};
+
+typedef struct PersistEntry {
+  uint32_t key;
+  bool used;
+  uint16_t size;
+  uint8_t data[PERSIST_DATA_MAX];
+} PersistEntry;
+
+static uint64_t s_now_ms;
+static GBitmap s_fb;
+static uint8_t s_fb_data[PBL_DISPLAY_HEIGHT * PBL_IF_COLOR_ELSE(PBL_DISPLAY_WIDTH, 20)];
+static GContext s_ctx;
+static MockDrawStats s_draw;
+static MockCounters s_counters;
+static Window *s_window;
+static bool s_dirty;
+static size_t s_heap_used;
+static PersistEntry s_persist[PERSIST_SLOTS];
+static struct MockFont s_fonts[2];
+static AppTimer *s_timers;
+static time_t s_last_tick;
+
+static TickHandler s_tick_handler;
+static BatteryStateHandler s_battery_handler;
+static BatteryChargeState s_battery = { .charge_percent = 80 };
+static ConnectionHandler s_connection_handler;
+static bool s_connected = true;
+static AccelTapHandler s_tap_handler;
+static HealthEventHandler s_health_handler;
+static HealthValue s_steps = 4200, s_steps_average = 8000;
+
+static AppMessageInboxReceived s_inbox_received;
+static AppMessageInboxDropped s_inbox_dropped;
+static AppMessageOutboxSent s_outbox_sent;
+static AppMessageOutboxFailed s_outbox_failed;
+static DictionaryIterator s_outbox, s_inbox;
+static bool s_outbox_pending;
+static uint64_t s_outbox_due_ms;
+static MockPhoneHandler s_phone;
+
+
+/////////////////////////
+// heap with a counter //
+/////////////////////////
+static void *heap_alloc(size_t size) {
+  size_t *block = calloc(1, sizeof(size_t) + size);
+  if(!block || s_heap_used + size > HEAP_SIZE) {
+    free(block);
+    return NULL;
+  }
+  *block = size;
+  s_heap_used += size;
+  return block + 1;
+}
+
+
+static void heap_free(void *ptr) {
+  if(ptr) {
+    size_t *block = (size_t *)ptr - 1;
+    s_heap_used -= *block;
+    free(block);
+  }
+}
+
+
+size_t heap_bytes_used(void) {
+  return s_heap_used;
+}
+
+
+size_t heap_bytes_free(void) {
+  return HEAP_SIZE - s_heap_used;
+}
+
+
+///////////////////////
+// clock and logging //
+///////////////////////
+void mock_set_time(time_t now) {
+  s_now_ms = (uint64_t)now * 1000;
+}
+
+
+time_t mock_time(time_t *tloc) {
+  time_t now = s_now_ms / 1000;
+  if(tloc) {
+    *tloc = now;
+  }
+  return now;
+}
+
+
+uint16_t time_ms(time_t *tloc, uint16_t *out_ms) {
+  uint16_t ms = s_now_ms % 1000;
+  mock_time(tloc);
+  if(out_ms) {
+    *out_ms = ms;
+  }
+  return ms;
+}
+
+
+time_t time_start_of_today(void) {
+  time_t now = mock_time(NULL);
+  return now - (now % SECONDS_PER_DAY);
+}
+
+
+uint64_t mock_now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((uint64_t)ts.tv_sec * 1000000000) + ts.tv_nsec;
+}
+
+
+void mock_log(uint8_t level, const char *file, int line, const char *fmt, ...) {
+  // quiet unless asked for, the harness prints its own report
+  if(!getenv("MOCK_LOG")) {
+    return;
+  }
+  va_list args;
+  va_start(args, fmt);
+  fprintf(stderr, "[%d] %s:%d ", level, file, line);
+  vfprintf(stderr, fmt, args);
+  fputc('\n', stderr);
+  va_end(args);
+}
+
+
+int32_t sin_lookup(int32_t angle) {
+  return (int32_t)lround(sin(angle * 2 * M_PI / TRIG_MAX_ANGLE) * TRIG_MAX_RATIO);
+}
+
+
+int32_t cos_lookup(int32_t angle) {
+  return (int32_t)lround(cos(angle * 2 * M_PI / TRIG_MAX_ANGLE) * TRIG_MAX_RATIO);
+}
+
+
+//////////////
+// geometry //
+//////////////
+bool gcolor_equal(GColor8 x, GColor8 y) {
+  return x.argb == y.argb || (x.a == 0 && y.a == 0);
+}
+
+
+bool grect_equal(const GRect *rect_a, const GRect *rect_b) {
+  return memcmp(rect_a, rect_b, sizeof(GRect)) == 0;
+}
+
+
+bool grect_is_empty(const GRect *rect) {
+  return rect->size.w == 0 || rect->size.h == 0;
+}
+
+
+static GRect grect_standardize(GRect rect) {
+  if(rect.size.w < 0) {
+    rect.origin.x += rect.size.w;
+    rect.size.w = -rect.size.w;
+  }
+  if(rect.size.h < 0) {
+    rect.origin.y += rect.size.h;
+    rect.size.h = -rect.size.h;
+  }
+  return rect;
+}
+
+
+void grect_clip(GRect *rect_to_clip, const GRect *rect_clipper) {
+  GRect a = grect_standardize(*rect_to_clip), b = grect_standardize(*rect_clipper);
+  int x0 = MAX(a.origin.x, b.origin.x), y0 = MAX(a.origin.y, b.origin.y);
+  int x1 = MIN(a.origin.x + a.size.w, b.origin.x + b.size.w);
+  int y1 = MIN(a.origin.y + a.size.h, b.origin.y + b.size.h);
+  *rect_to_clip = (x1 > x0 && y1 > y0) ? GRect(x0, y0, x1 - x0, y1 - y0) : GRectZero;
+}
+
+
+void grect_align(GRect *rect, const GRect *inside_rect, const GAlign alignment, const bool clip) {
+  int dx = inside_rect->size.w - rect->size.w, dy = inside_rect->size.h - rect->size.h;
+  int x = dx / 2, y = dy / 2;
+  switch(alignment) {
+    case GAlignTopLeft: x = 0; y = 0; break;
+    case GAlignTopRight: x = dx; y = 0; break;
+    case GAlignTop: y = 0; break;
+    case GAlignLeft: x = 0; break;
+    case GAlignBottom: y = dy; break;
+    case GAlignRight: x = dx; break;
+    case GAlignBottomRight: x = dx; y = dy; break;
+    case GAlignBottomLeft: x = 0; y = dy; break;
+    default: break;
+  }
+  rect->origin = GPoint(inside_rect->origin.x + x, inside_rect->origin.y + y);
+  if(clip) {
+    grect_clip(rect, inside_rect);
+  }
+}
+
+
+GPoint grect_center_point(const GRect *rect) {
+  return GPoint(rect->origin.x + (rect->size.w / 2), rect->origin.y + (rect->size.h / 2));
+}
+
+
+/////////////
+// bitmaps //
+/////////////
+static int format_bits(GBitmapFormat format) {
+  switch(format) {
+    case GBitmapFormat1Bit: return 1;
+    case GBitmapFormat1BitPalette: return 1;
+    case GBitmapFormat2BitPalette: return 2;
+    case GBitmapFormat4BitPalette: return 4;
+    default: return 8;
+  }
+}
+
+
+static uint16_t format_row_size(GBitmapFormat format, int width) {
+  if(format == GBitmapFormat1Bit) {
+    return ((width + 31) / 32) * 4; // word aligned like the SDK
+  }
+  return ((width * format_bits(format)) + 7) / 8;
+}
+
+
+static GBitmap *bitmap_alloc(GSize size, GBitmapFormat format) {
+  GBitmap *bitmap = heap_alloc(sizeof(GBitmap));
+  if(!bitmap) {
+    return NULL;
+  }
+  bitmap->format = format;
+  bitmap->size = size;
+  bitmap->bounds = GRect(0, 0, size.w, size.h);
+  bitmap->row_size = format_row_size(format, size.w);
+  bitmap->data = heap_alloc(bitmap->row_size * size.h);
+  s_counters.bitmap_allocs++;
+  s_counters.bitmap_bytes += bitmap->row_size * size.h;
+  if(format == GBitmapFormat1BitPalette || format == GBitmapFormat2BitPalette || format == GBitmapFormat4BitPalette) {
+    bitmap->palette = heap_alloc(sizeof(GColor) << format_bits(format));
+  }
+  if(!bitmap->data || (format_bits(format) < 8 && format != GBitmapFormat1Bit && !bitmap->palette)) {
+    gbitmap_destroy(bitmap);
+    return NULL;
+  }
+  return bitmap;
+}
+
+
+GBitmap *gbitmap_create_blank(GSize size, GBitmapFormat format) {
+  return bitmap_alloc(size, format);
+}
+
+
+GBitmap *gbitmap_create_with_resource(uint32_t resource_id) {
+  const MockImage *image = NULL;
+  for(int i=0; i<mock_image_count; i++) {
+    if(mock_images[i].resource_id == resource_id) {
+      image = &mock_images[i];
+    }
+  }
+  if(!image) {
+    APP_LOG(APP_LOG_LEVEL_ERROR, "no image for resource %d", (int)resource_id);
+    return NULL;
+  }
+
+  // same formats the resource compiler picks in package.json:
+  // 1Bit on black and white, a two color palette on color
+  GBitmap *bitmap = bitmap_alloc(GSize(image->width, image->height),
+                                 PBL_IF_COLOR_ELSE(GBitmapFormat1BitPalette, GBitmapFormat1Bit));
+  if(!bitmap) {
+    return NULL;
+  }
+  for(int y=0; y<image->height; y++) {
+    for(int x=0; x<image->width; x++) {
+      if(image->mask[(y * image->width) + x]) {
+        uint8_t *byte = &bitmap->data[(y * bitmap->row_size) + (x / 8)];
+        *byte |= PBL_IF_COLOR_ELSE(0x80 >> (x % 8), 1 << (x % 8));
+      }
+    }
+  }
+  if(bitmap->palette) {
+    bitmap->palette[0] = GColorClear;
+    bitmap->palette[1] = GColorWhite;
+  }
+  return bitmap;
+}
+
+
+void gbitmap_destroy(GBitmap *bitmap) {
+  if(!bitmap || bitmap == &s_fb) {
+    return;
+  }
+  heap_free(bitmap->data);
+  heap_free(bitmap->palette);
+  heap_free(bitmap);
+}
+
+
+GRect gbitmap_get_bounds(const GBitmap *bitmap) {
+  return bitmap->bounds;
+}
+
+
+void gbitmap_set_bounds(GBitmap *bitmap, GRect bounds) {
+  bitmap->bounds = bounds;
+}
+
+
+GBitmapFormat gbitmap_get_format(const GBitmap *bitmap) {
+  return bitmap->format;
+}
+
+
+uint8_t *gbitmap_get_data(const GBitmap *bitmap) {
+  return bitmap->data;
+}
+
+
+uint16_t gbitmap_get_bytes_per_row(const GBitmap *bitmap) {
+  return bitmap->row_size;
+}
+
+
+GColor *gbitmap_get_palette(const GBitmap *bitmap) {
+  return bitmap->palette;
+}
+
+
+/////////////////////////////////////
+// is pixel on the physical screen //
+/////////////////////////////////////
+static bool screen_visible(int x, int y) {
+  if(x < 0 || y < 0 || x >= PBL_DISPLAY_WIDTH || y >= PBL_DISPLAY_HEIGHT) {
+    return false;
+  }
+#if defined(PBL_ROUND)
+  int dx = (2 * x) - (PBL_DISPLAY_WIDTH - 1), dy = (2 * y) - (PBL_DISPLAY_HEIGHT - 1);
+  return (dx * dx) + (dy * dy) <= PBL_DISPLAY_WIDTH * PBL_DISPLAY_WIDTH;
+#else
+  return true;
+#endif
+}
+
+
+GBitmapDataRowInfo gbitmap_get_data_row_info(const GBitmap *bitmap, uint16_t y) {
+  GBitmapDataRowInfo info = { &bitmap->data[y * bitmap->row_size], 0, bitmap->size.w - 1 };
+  if(bitmap->format == GBitmapFormat8BitCircular) {
+    while(info.min_x < info.max_x && !screen_visible(info.min_x, y)) {
+      info.min_x++;
+    }
+    while(info.max_x > info.min_x && !screen_visible(info.max_x, y)) {
+      info.max_x--;
+    }
+  }
+  return info;
+}
+
+
+static GColor bitmap_get_pixel(const GBitmap *bitmap, int x, int y) {
+  const uint8_t *row = &bitmap->data[y * bitmap->row_size];
+  switch(bitmap->format) {
+    case GBitmapFormat1Bit:
+      return (row[x / 8] >> (x % 8)) & 1 ? GColorWhite : GColorBlack;
+    case GBitmapFormat8Bit:
+    case GBitmapFormat8BitCircular:
+      return (GColor) { .argb = row[x] };
+    default: {
+      int bits = format_bits(bitmap->format);
+      int shift = 8 - bits - ((x * bits) % 8);
+      return bitmap->palette[(row[(x * bits) / 8] >> shift) & ((1 << bits) - 1)];
+    }
+  }
+}
+
+
+#if !defined(PBL_COLOR)
+static bool color_is_white(GColor color) {
+  // how a color comes out on a black and white screen
+  return color.r + color.g + color.b >= 5;
+}
+#endif
+
+
+static void fb_set_pixel(int x, int y, GColor color) {
+  uint8_t *row = &s_fb.data[y * s_fb.row_size];
+#if defined(PBL_COLOR)
+  row[x] = color.argb | 0xC0;
+#else
+  if(color_is_white(color)) {
+    row[x / 8] |= 1 << (x % 8);
+  } else {
+    row[x / 8] &= ~(1 << (x % 8));
+  }
+#endif
+}
+
+
+GBitmap *mock_framebuffer(void) {
+  return &s_fb;
+}
+
+
+//////////////////////////////////////////////
+// FNV-1a of the visible pixels, as GColor8 //
+//////////////////////////////////////////////
+uint32_t mock_framebuffer_hash(void) {
+  uint32_t hash = 2166136261u;
+  for(int y=0; y<PBL_DISPLAY_HEIGHT; y++) {
+    for(int x=0; x<PBL_DISPLAY_WIDTH; x++) {
+      if(screen_visible(x, y)) {
+        hash = (hash ^ (bitmap_get_pixel(&s_fb, x, y).argb | 0xC0)) * 16777619u;
+      }
+    }
+  }
+  return hash;
+}
+
+
+bool mock_framebuffer_write_ppm(const char *path) {
+  FILE *file = fopen(path, "wb");
+  if(!file) {
+    return false;
+  }
+  fprintf(file, "P6\n%d %d\n255\n", PBL_DISPLAY_WIDTH, PBL_DISPLAY_HEIGHT);
+  for(int y=0; y<PBL_DISPLAY_HEIGHT; y++) {
+    for(int x=0; x<PBL_DISPLAY_WIDTH; x++) {
+      // outside a round screen is left black
+      GColor color = screen_visible(x, y) ? bitmap_get_pixel(&s_fb, x, y) : GColorBlack;
+      uint8_t rgb[3] = { color.r * 85, color.g * 85, color.b * 85 };
+      fwrite(rgb, 1, sizeof(rgb), file);
+    }
+  }
+  return fclose(file) == 0;
+}
+
+
+/////////////////////////////////
+// write one pixel through ctx //
+/////////////////////////////////
+static void plot(GContext *ctx, int x, int y, GColor color, uint32_t *counter) {
+  x += ctx->offset.x;
+  y += ctx->offset.y;
+  if(color.a == 0 || x < ctx->clip.origin.x || y < ctx->clip.origin.y ||
+     x >= ctx->clip.origin.x + ctx->clip.size.w || y >= ctx->clip.origin.y + ctx->clip.size.h ||
+     !screen_visible(x, y)) {
+    return;
+  }
+  fb_set_pixel(x, y, color);
+  (*counter)++;
+}
+
+
+//////////////////////
+// graphics context //
+//////////////////////
+static void context_reset(GContext *ctx, GPoint offset, GRect clip) {
+  *ctx = (GContext) {
+    .fb = &s_fb,
+    .offset = offset,
+    .clip = clip,
+    .stroke_color = GColorBlack,
+    .fill_color = GColorBlack,
+    .text_color = GColorBlack,
+    .compositing = GCompOpAssign,
+    .stroke_width = 1,
+    .antialiased = true,
+  };
+}
+
+
+GContext *mock_context(void) {
+  context_reset(&s_ctx, GPointZero, GRect(0, 0, PBL_DISPLAY_WIDTH, PBL_DISPLAY_HEIGHT));
+  return &s_ctx;
+}
+
+
+void graphics_context_set_stroke_color(GContext *ctx, GColor color) {
+  ctx->stroke_color = color;
+}
+
+
+void graphics_context_set_fill_color(GContext *ctx, GColor color) {
+  ctx->fill_color = color;
+}
+
+
+void graphics_context_set_text_color(GContext *ctx, GColor color) {
+  ctx->text_color = color;
+}
+
+
+void graphics_context_set_compositing_mode(GContext *ctx, GCompOp mode) {
+  ctx->compositing = mode;
+}
+
+
+void graphics_context_set_antialiased(GContext *ctx, bool enable) {
+  ctx->antialiased = enable;
+}
+
+
+void graphics_context_set_stroke_width(GContext *ctx, uint8_t stroke_width) {
+  // the SDK only draws odd widths
+  ctx->stroke_width = stroke_width | 1;
+}
+
+
+GBitmap *graphics_capture_frame_buffer(GContext *ctx) {
+  return ctx->fb;
+}
+
+
+bool graphics_release_frame_buffer(GContext *ctx, GBitmap *buffer) {
+  return buffer == ctx->fb;
+}
+
+
+///////////
+// lines //
+///////////
+void graphics_draw_line(GContext *ctx, GPoint p0, GPoint p1) {
+  s_draw.draw_calls++;
+
+  if(ctx->stroke_width <= 1) {
+    // Bresenham
+    int dx = abs(p1.x - p0.x), sx = p0.x < p1.x ? 1 : -1;
+    int dy = -abs(p1.y - p0.y), sy = p0.y < p1.y ? 1 : -1;
+    int err = dx + dy, x = p0.x, y = p0.y;
+    for(;;) {
+      plot(ctx, x, y, ctx->stroke_color, &s_draw.stroke_pixels);
+      if(x == p1.x && y == p1.y) {
+        break;
+      }
+      int e2 = 2 * err;
+      if(e2 >= dy) {
+        err += dy;
+        x += sx;
+      }
+      if(e2 <= dx) {
+        err += dx;
+        y += sy;
+      }
+    }
+    return;
+  }
+
+  // wide lines have round caps, every pixel near enough the segment
+  double half = ctx->stroke_width / 2.0;
+  int pad = ctx->stroke_width / 2 + 1;
+  double vx = p1.x - p0.x, vy = p1.y - p0.y, len2 = (vx * vx) + (vy * vy);
+  for(int y=MIN(p0.y, p1.y)-pad; y<=MAX(p0.y, p1.y)+pad; y++) {
+    for(int x=MIN(p0.x, p1.x)-pad; x<=MAX(p0.x, p1.x)+pad; x++) {
+      double t = len2 > 0 ? (((x - p0.x) * vx) + ((y - p0.y) * vy)) / len2 : 0;
+      t = t < 0 ? 0 : t > 1 ? 1 : t;
+      double ex = x - (p0.x + (t * vx)), ey = y - (p0.y + (t * vy));
+      if((ex * ex) + (ey * ey) <= half * half) {
+        plot(ctx, x, y, ctx->stroke_color, &s_draw.stroke_pixels);
+      }
+    }
+  }
+}
+
+
+/////////////
+// circles //
+/////////////
+void graphics_draw_circle(GContext *ctx, GPoint p, uint16_t radius) {
+  s_draw.draw_calls++;
+  double half = ctx->stroke_width / 2.0;
+  int extent = radius + ctx->stroke_width;
+  for(int dy=-extent; dy<=extent; dy++) {
+    for(int dx=-extent; dx<=extent; dx++) {
+      if(fabs(sqrt((dx * dx) + (dy * dy)) - radius) <= half) {
+        plot(ctx, p.x + dx, p.y + dy, ctx->stroke_color, &s_draw.stroke_pixels);
+      }
+    }
+  }
+}
+
+
+void graphics_fill_circle(GContext *ctx, GPoint p, uint16_t radius) {
+  s_draw.draw_calls++;
+  s_draw.fills++;
+  int r = radius;
+  for(int dy=-r; dy<=r; dy++) {
+    for(int dx=-r; dx<=r; dx++) {
+      if((dx * dx) + (dy * dy) <= (r * r) + r) {
+        plot(ctx, p.x + dx, p.y + dy, ctx->fill_color, &s_draw.fill_pixels);
+      }
+    }
+  }
+}
+
+
+///////////////////////////////////////////////
+// is pixel inside rect with rounded corners //
+///////////////////////////////////////////////
+static bool round_rect_contains(GRect rect, int radius, GCornerMask corners, int x, int y) {
+  int x0 = rect.origin.x, y0 = rect.origin.y, x1 = x0 + rect.size.w, y1 = y0 + rect.size.h;
+  if(x < x0 || y < y0 || x >= x1 || y >= y1) {
+    return false;
+  }
+  radius = MIN(radius, MIN(rect.size.w, rect.size.h) / 2);
+  if(radius <= 0) {
+    return true;
+  }
+
+  double cx, cy;
+  if(x < x0 + radius && y < y0 + radius && (corners & GCornerTopLeft)) {
+    cx = x0 + radius; cy = y0 + radius;
+  } else if(x >= x1 - radius && y < y0 + radius && (corners & GCornerTopRight)) {
+    cx = x1 - radius; cy = y0 + radius;
+  } else if(x < x0 + radius && y >= y1 - radius && (corners & GCornerBottomLeft)) {
+    cx = x0 + radius; cy = y1 - radius;
+  } else if(x >= x1 - radius && y >= y1 - radius && (corners & GCornerBottomRight)) {
+    cx = x1 - radius; cy = y1 - radius;
+  } else {
+    return true;
+  }
+  double dx = (x + 0.5) - cx, dy = (y + 0.5) - cy;
+  return (dx * dx) + (dy * dy) <= radius * radius;
+}
+
+
+////////////////
+// rectangles //
+////////////////
+void graphics_draw_round_rect(GContext *ctx, GRect rect, uint16_t radius) {
+  s_draw.draw_calls++;
+  int w = ctx->stroke_width;
+  GRect inner = GRect(rect.origin.x + w, rect.origin.y + w, rect.size.w - (2 * w), rect.size.h - (2 * w));
+  for(int y=rect.origin.y; y<rect.origin.y+rect.size.h; y++) {
+    for(int x=rect.origin.x; x<rect.origin.x+rect.size.w; x++) {
+      if(round_rect_contains(rect, radius, GCornersAll, x, y) &&
+         !round_rect_contains(inner, MAX(radius - w, 0), GCornersAll, x, y)) {
+        plot(ctx, x, y, ctx->stroke_color, &s_draw.stroke_pixels);
+      }
+    }
+  }
+}
+
+
+void graphics_draw_rect(GContext *ctx, GRect rect) {
+  graphics_draw_round_rect(ctx, rect, 0);
+}
+
+
+void graphics_fill_rect(GContext *ctx, GRect rect, uint16_t corner_radius, GCornerMask corner_mask) {
+  s_draw.draw_calls++;
+  s_draw.fills++;
+  rect = grect_standardize(rect);
+  for(int y=rect.origin.y; y<rect.origin.y+rect.size.h; y++) {
+    for(int x=rect.origin.x; x<rect.origin.x+rect.size.w; x++) {
+      if(round_rect_contains(rect, corner_radius, corner_mask, x, y)) {
+        plot(ctx, x, y, ctx->fill_color, &s_draw.fill_pixels);
+      }
+    }
+  }
+}
+
+
+//////////////////////////////////////////////
+// ring segment, 0 is 12 o'clock, clockwise //
+//////////////////////////////////////////////
+void graphics_fill_radial(GContext *ctx, GRect rect, GOvalScaleMode scale_mode, uint16_t inset_thickness,
+                          int32_t angle_start, int32_t angle_end) {
+  s_draw.draw_calls++;
+  s_draw.fills++;
+  if(angle_end <= angle_start) {
+    return;
+  }
+
+  double cx = rect.origin.x + ((rect.size.w - 1) / 2.0), cy = rect.origin.y + ((rect.size.h - 1) / 2.0);
+  double outer = (scale_mode == GOvalScaleModeFitCircle ? MIN(rect.size.w, rect.size.h) : MAX(rect.size.w, rect.size.h)) / 2.0;
+  double inner = outer - inset_thickness;
+  for(int y=rect.origin.y; y<rect.origin.y+rect.size.h; y++) {
+    for(int x=rect.origin.x; x<rect.origin.x+rect.size.w; x++) {
+      double dx = x - cx, dy = y - cy, d = sqrt((dx * dx) + (dy * dy));
+      if(d > outer || d < inner) {
+        continue;
+      }
+      double turn = atan2(dx, -dy) / (2 * M_PI);
+      int32_t angle = (int32_t)((turn < 0 ? turn + 1 : turn) * TRIG_MAX_ANGLE);
+      if((angle >= angle_start && angle <= angle_end) ||
+         (angle + TRIG_MAX_ANGLE >= angle_start && angle + TRIG_MAX_ANGLE <= angle_end)) {
+        plot(ctx, x, y, ctx->fill_color, &s_draw.fill_pixels);
+      }
+    }
+  }
+}
+
+
+////////////////////////////////////////////
+// blit, tiling if rect is bigger than it //
+////////////////////////////////////////////
+void graphics_draw_bitmap_in_rect(GContext *ctx, const GBitmap *bitmap, GRect rect) {
+  s_draw.draw_calls++;
+  if(!bitmap || grect_is_empty(&bitmap->bounds)) {
+    return;
+  }
+
+  GRect src = bitmap->bounds;
+  for(int y=0; y<rect.size.h; y++) {
+    for(int x=0; x<rect.size.w; x++) {
+      GColor color = bitmap_get_pixel(bitmap, src.origin.x + (x % src.size.w), src.origin.y + (y % src.size.h));
+#if defined(PBL_COLOR)
+      // color screens only know assign and alpha blending
+      if(ctx->compositing == GCompOpSet && color.a == 0) {
+        continue;
+      }
+      color.a = 3;
+#else
+      int sx = rect.origin.x + x + ctx->offset.x, sy = rect.origin.y + y + ctx->offset.y;
+      if(sx < 0 || sy < 0 || sx >= PBL_DISPLAY_WIDTH || sy >= PBL_DISPLAY_HEIGHT) {
+        continue;
+      }
+      bool s = color.a != 0 && color_is_white(color);
+      bool d = color_is_white(bitmap_get_pixel(&s_fb, sx, sy));
+      switch(ctx->compositing) {
+        case GCompOpAssignInverted: s = !s; break;
+        case GCompOpOr: s = s || d; break;
+        case GCompOpAnd: s = s && d; break;
+        case GCompOpClear: s = !s && d; break;
+        case GCompOpSet: s = !s || d; break;
+        default: break;
+      }
+      color = s ? GColorWhite : GColorBlack;
+#endif
+      plot(ctx, rect.origin.x + x, rect.origin.y + y, color, &s_draw.blit_pixels);
+    }
+  }
+}
+
+
+//////////
+// text //
+//////////
+// 3x5 block glyphs drawn at twice the size, rows top down, 3 bits each
+static uint16_t glyph_bits(uint32_t c) {
+  static const uint16_t digits[10] = {
+    075557, 026227, 071747, 071717, 055711, 074717, 074757, 071111, 075757, 075717,
+  };
+  static const uint16_t letters[26] = {
+    025755, 065656, 034443, 065556, 074647, 074644, 034553, 055755, 072227, 011152,
+    055655, 044447, 057755, 065555, 025552, 065644, 025563, 065655, 034216, 072222,
+    055557, 055552, 055775, 055255, 055222, 071247,
+  };
+  if(c >= '0' && c <= '9') {
+    return digits[c - '0'];
+  }
+  if(c >= 'A' && c <= 'Z') {
+    return letters[c - 'A'];
+  }
+  switch(c) {
+    case 'k': return 045655;
+    case '-': return 000700;
+    case ' ': return 0;
+    case 0xB0: return 025200; // degree sign
+    default: return 077777;
+  }
+}
+
+
+static int text_decode(const char *text, uint32_t *out, int max) {
+  int count = 0;
+  for(const unsigned char *p = (const unsigned char *)text; *p && count < max; p++) {
+    if(*p == 0xC2 && p[1]) {
+      p++; // two byte UTF-8, only the degree sign is used
+    }
+    out[count++] = *p;
+  }
+  return count;
+}
+
+
+void graphics_draw_text(GContext *ctx, const char *text, GFont const font, const GRect box,
+                        const GTextOverflowMode overflow_mode, const GTextAlignment alignment,
+                        GTextAttributes *text_attributes) {
+  s_draw.draw_calls++;
+  if(!text) {
+    return;
+  }
+
+  uint32_t chars[32];
+  int count = text_decode(text, chars, ARRAY_LENGTH(chars));
+  int width = count > 0 ? (count * 8) - 2 : 0;
+  int x = box.origin.x;
+  if(alignment == GTextAlignmentCenter) {
+    x += (box.size.w - width) / 2;
+  } else if(alignment == GTextAlignmentRight) {
+    x += box.size.w - width;
+  }
+
+  GRect clip = ctx->clip;
+  GRect text_box = GRect(box.origin.x + ctx->offset.x, box.origin.y + ctx->offset.y, box.size.w, box.size.h);
+  grect_clip(&ctx->clip, &text_box);
+  for(int i=0; i<count; i++) {
+    uint16_t bits = glyph_bits(chars[i]);
+    for(int gy=0; gy<5; gy++) {
+      for(int gx=0; gx<3; gx++) {
+        if(bits & (1 << (14 - (gy * 3) - gx))) {
+          for(int s=0; s<4; s++) {
+            plot(ctx, x + (i * 8) + (gx * 2) + (s % 2), box.origin.y + 2 + (gy * 2) + (s / 2),
+                 ctx->text_color, &s_draw.text_pixels);
+          }
+        }
+      }
+    }
+  }
+  ctx->clip = clip;
+}
+
+
+ResHandle resource_get_handle(uint32_t resource_id) {
+  return (ResHandle)(uintptr_t)resource_id;
+}
+
+
+GFont fonts_load_custom_font(ResHandle handle) {
+  struct MockFont *font = &s_fonts[(uintptr_t)handle % ARRAY_LENGTH(s_fonts)];
+  font->resource_id = (uintptr_t)handle;
+  return font;
+}
+
+
+void fonts_unload_custom_font(GFont font) {
+}
+
+
+GFont fonts_get_system_font(const char *font_key) {
+  static struct MockFont system_font;
+  return &system_font;
+}
+
+
+MockDrawStats mock_draw_stats_take(void) {
+  MockDrawStats stats = s_draw;
+  s_draw = (MockDrawStats) { 0 };
+  return stats;
+}
+
+
+/////////////
+// storage //
+/////////////
+static PersistEntry *persist_find(uint32_t key) {
+  for(int i=0; i<PERSIST_SLOTS; i++) {
+    if(s_persist[i].used && s_persist[i].key == key) {
+      return &s_persist[i];
+    }
+  }
+  return NULL;
+}
+
+
+bool persist_exists(const uint32_t key) {
+  return persist_find(key) != NULL;
+}
+
+
+int persist_read_data(const uint32_t key, void *buffer, const size_t buffer_size) {
+  PersistEntry *entry = persist_find(key);
+  if(!entry) {
+    return -1; // E_DOES_NOT_EXIST
+  }
+  size_t size = MIN(buffer_size, entry->size);
+  memcpy(buffer, entry->data, size);
+  return size;
+}
+
+
+int persist_write_data(const uint32_t key, const void *data, const size_t size) {
+  PersistEntry *entry = persist_find(key);
+  for(int i=0; !entry && i<PERSIST_SLOTS; i++) {
+    if(!s_persist[i].used) {
+      entry = &s_persist[i];
+    }
+  }
+  if(!entry || size > PERSIST_DATA_MAX) {
+    return -4; // E_OUT_OF_STORAGE
+  }
+  entry->key = key;
+  entry->used = true;
+  entry->size = size;
+  memcpy(entry->data, data, size);
+  s_counters.flash_writes++;
+  s_counters.flash_bytes += size;
+  return size;
+}
+
+
+int persist_delete(const uint32_t key) {
+  PersistEntry *entry = persist_find(key);
+  if(entry) {
+    entry->used = false;
+  }
+  return 0;
+}
+
+
+////////////
+// layers //
+////////////
+// something on screen changed, the next render draws the window
+static void invalidate(void) {
+  s_dirty = true;
+  s_counters.invalidations++;
+}
+
+
+static void layer_init(Layer *layer, LayerKind kind, GRect frame) {
+  *layer = (Layer) {
+    .kind = kind,
+    .frame = frame,
+    .bounds = GRect(0, 0, frame.size.w, frame.size.h),
+  };
+}
+
+
+static void layer_unlink(Layer *layer) {
+  Layer *parent = layer->parent;
+  if(!parent) {
+    return;
+  }
+  for(Layer **link = &parent->first_child; *link; link = &(*link)->next_sibling) {
+    if(*link == layer) {
+      *link = layer->next_sibling;
+      break;
+    }
+  }
+  layer->parent = NULL;
+  layer->next_sibling = NULL;
+}
+
+
+Layer *layer_create(GRect frame) {
+  Layer *layer = heap_alloc(sizeof(Layer));
+  if(layer) {
+    layer_init(layer, LAYER_PLAIN, frame);
+  }
+  return layer;
+}
+
+
+void layer_destroy(Layer *layer) {
+  if(layer) {
+    layer_unlink(layer);
+    heap_free(layer);
+  }
+}
+
+
+void layer_set_update_proc(Layer *layer, LayerUpdateProc update_proc) {
+  layer->update_proc = update_proc;
+}
+
+
+void layer_add_child(Layer *parent, Layer *child) {
+  layer_unlink(child);
+  Layer **link = &parent->first_child;
+  while(*link) {
+    link = &(*link)->next_sibling;
+  }
+  *link = child;
+  child->parent = parent;
+  invalidate();
+}
+
+
+void layer_mark_dirty(Layer *layer) {
+  invalidate();
+}
+
+
+GRect layer_get_bounds(const Layer *layer) {
+  return layer->bounds;
+}
+
+
+GRect layer_get_frame(const Layer *layer) {
+  return layer->frame;
+}
+
+
+void layer_set_hidden(Layer *layer, bool hidden) {
+  if(layer->hidden != hidden) {
+    layer->hidden = hidden;
+    invalidate();
+  }
+}
+
+
+bool layer_get_hidden(const Layer *layer) {
+  return layer->hidden;
+}
+
+
+TextLayer *text_layer_create(GRect frame) {
+  TextLayer *text_layer = heap_alloc(sizeof(TextLayer));
+  if(text_layer) {
+    layer_init(&text_layer->layer, LAYER_TEXT, frame);
+    text_layer->text_color = GColorBlack;
+    text_layer->background_color = GColorWhite;
+  }
+  return text_layer;
+}
+
+
+void text_layer_destroy(TextLayer *text_layer) {
+  if(text_layer) {
+    layer_unlink(&text_layer->layer);
+    heap_free(text_layer);
+  }
+}
+
+
+Layer *text_layer_get_layer(TextLayer *text_layer) {
+  return &text_layer->layer;
+}
+
+
+void text_layer_set_text(TextLayer *text_layer, const char *text) {
+  text_layer->text = text;
+  invalidate();
+}
+
+
+void text_layer_set_font(TextLayer *text_layer, GFont font) {
+  text_layer->font = font;
+  invalidate();
+}
+
+
+void text_layer_set_text_color(TextLayer *text_layer, GColor color) {
+  text_layer->text_color = color;
+  invalidate();
+}
+
+
+void text_layer_set_background_color(TextLayer *text_layer, GColor color) {
+  text_layer->background_color = color;
+  invalidate();
+}
+
+
+void text_layer_set_text_alignment(TextLayer *text_layer, GTextAlignment text_alignment) {
+  text_layer->alignment = text_alignment;
+  invalidate();
+}
+
+
+BitmapLayer *bitmap_layer_create(GRect frame) {
+  BitmapLayer *bitmap_layer = heap_alloc(sizeof(BitmapLayer));
+  if(bitmap_layer) {
+    layer_init(&bitmap_layer->layer, LAYER_BITMAP, frame);
+    bitmap_layer->background_color = GColorClear;
+    bitmap_layer->compositing = GCompOpAssign;
+  }
+  return bitmap_layer;
+}
+
+
+void bitmap_layer_destroy(BitmapLayer *bitmap_layer) {
+  if(bitmap_layer) {
+    layer_unlink(&bitmap_layer->layer);
+    heap_free(bitmap_layer);
+  }
+}
+
+
+Layer *bitmap_layer_get_layer(const BitmapLayer *bitmap_layer) {
+  return (Layer *)&bitmap_layer->layer;
+}
+
+
+void bitmap_layer_set_bitmap(BitmapLayer *bitmap_layer, const GBitmap *bitmap) {
+  bitmap_layer->bitmap = bitmap;
+  invalidate();
+}
+
+
+void bitmap_layer_set_compositing_mode(BitmapLayer *bitmap_layer, GCompOp mode) {
+  bitmap_layer->compositing = mode;
+  invalidate();
+}
+
+
+/////////////
+// windows //
+/////////////
+Window *window_create(void) {
+  Window *window = heap_alloc(sizeof(Window));
+  if(window) {
+    window->root = layer_create(GRect(0, 0, PBL_DISPLAY_WIDTH, PBL_DISPLAY_HEIGHT));
+    window->background_color = GColorWhite;
+  }
+  return window;
+}
+
+
+void window_destroy(Window *window) {
+  if(!window) {
+    return;
+  }
+  if(window == s_window) {
+    if(window->handlers.disappear) {
+      window->handlers.disappear(window);
+    }
+    if(window->handlers.unload) {
+      window->handlers.unload(window);
+    }
+    s_window = NULL;
+  }
+  layer_destroy(window->root);
+  heap_free(window);
+}
+
+
+void window_set_window_handlers(Window *window, WindowHandlers handlers) {
+  window->handlers = handlers;
+}
+
+
+void window_set_background_color(Window *window, GColor background_color) {
+  window->background_color = background_color;
+  invalidate();
+}
+
+
+Layer *window_get_root_layer(const Window *window) {
+  return window->root;
+}
+
+
+void window_stack_push(Window *window, bool animated) {
+  s_window = window;
+  if(window->handlers.load) {
+    window->handlers.load(window);
+  }
+  if(window->handlers.appear) {
+    window->handlers.appear(window);
+  }
+  invalidate();
+}
+
+
+///////////////////////////////////
+// draw a layer and its children //
+///////////////////////////////////
+static void render_layer(Layer *layer, GPoint parent_origin, GRect parent_clip) {
+  if(layer->hidden) {
+    return;
+  }
+  GPoint origin = GPoint(parent_origin.x + layer->frame.origin.x, parent_origin.y + layer->frame.origin.y);
+  GRect clip = GRect(origin.x, origin.y, layer->frame.size.w, layer->frame.size.h);
+  grect_clip(&clip, &parent_clip);
+
+  // every layer starts from the default drawing state
+  GContext *ctx = &s_ctx;
+  context_reset(ctx, GPoint(origin.x + layer->bounds.origin.x, origin.y + layer->bounds.origin.y), clip);
+
+  switch(layer->kind) {
+    case LAYER_TEXT: {
+      TextLayer *text_layer = (TextLayer *)layer;
+      if(text_layer->background_color.a) {
+        graphics_context_set_fill_color(ctx, text_layer->background_color);
+        graphics_fill_rect(ctx, layer->bounds, 0, GCornerNone);
+      }
+      graphics_context_set_text_color(ctx, text_layer->text_color);
+      graphics_draw_text(ctx, text_layer->text, text_layer->font, layer->bounds, GTextOverflowModeWordWrap,
+                         text_layer->alignment, NULL);
+      break;
+    }
+    case LAYER_BITMAP: {
+      BitmapLayer *bitmap_layer = (BitmapLayer *)layer;
+      if(bitmap_layer->background_color.a) {
+        graphics_context_set_fill_color(ctx, bitmap_layer->background_color);
+        graphics_fill_rect(ctx, layer->bounds, 0, GCornerNone);
+      }
+      if(bitmap_layer->bitmap) {
+        GRect rect = gbitmap_get_bounds(bitmap_layer->bitmap);
+        grect_align(&rect, &layer->bounds, GAlignCenter, false);
+        graphics_context_set_compositing_mode(ctx, bitmap_layer->compositing);
+        graphics_draw_bitmap_in_rect(ctx, bitmap_layer->bitmap, rect);
+      }
+      break;
+    }
+    default:
+      if(layer->update_proc) {
+        layer->update_proc(layer, ctx);
+      }
+      break;
+  }
+
+  for(Layer *child = layer->first_child; child; child = child->next_sibling) {
+    render_layer(child, origin, clip);
+  }
+}
+
+
+static uint64_t draw_pixels(const MockDrawStats *stats) {
+  return (uint64_t)stats->stroke_pixels + stats->fill_pixels + stats->blit_pixels + stats->text_pixels;
+}
+
+
+bool mock_render(void) {
+  if(!s_dirty || !s_window) {
+    return false;
+  }
+  s_dirty = false;
+  uint64_t pixels_before = draw_pixels(&s_draw);
+
+  GRect screen = GRect(0, 0, PBL_DISPLAY_WIDTH, PBL_DISPLAY_HEIGHT);
+  GContext *ctx = &s_ctx;
+  context_reset(ctx, GPointZero, screen);
+  // a clear background leaves the previous frame in place
+  if(s_window->background_color.a) {
+    graphics_context_set_fill_color(ctx, s_window->background_color);
+    graphics_fill_rect(ctx, screen, 0, GCornerNone);
+  }
+  render_layer(s_window->root, GPointZero, screen);
+
+  s_counters.frames++;
+  s_counters.frame_pixels += draw_pixels(&s_draw) - pixels_before;
+  return true;
+}
+
+
+//////////////
+// services //
+//////////////
+void tick_timer_service_subscribe(TimeUnits tick_units, TickHandler handler) {
+  s_tick_handler = handler;
+}
+
+
+void battery_state_service_subscribe(BatteryStateHandler handler) {
+  s_battery_handler = handler;
+}
+
+
+BatteryChargeState battery_state_service_peek(void) {
+  return s_battery;
+}
+
+
+void connection_service_subscribe(ConnectionHandlers conn_handlers) {
+  s_connection_handler = conn_handlers.pebble_app_connection_handler;
+}
+
+
+bool connection_service_peek_pebble_app_connection(void) {
+  return s_connected;
+}
+
+
+void accel_tap_service_subscribe(AccelTapHandler handler) {
+  s_tap_handler = handler;
+}
+
+
+void accel_tap_service_unsubscribe(void) {
+  s_tap_handler = NULL;
+}
+
+
+void vibes_double_pulse(void) {
+  s_counters.vibes++;
+}
+
+
+bool health_service_events_subscribe(HealthEventHandler handler, void *context) {
+  s_health_handler = handler;
+  return true;
+}
+
+
+bool health_service_events_unsubscribe(void) {
+  s_health_handler = NULL;
+  return true;
+}
+
+
+HealthValue health_service_sum_today(HealthMetric metric) {
+  return metric == HealthMetricStepCount ? s_steps : 0;
+}
+
+
+HealthValue health_service_sum_averaged(HealthMetric metric, time_t time_start, time_t time_end,
+                                        HealthServiceTimeScope scope) {
+  return metric == HealthMetricStepCount ? s_steps_average : 0;
+}
+
+
+HealthServiceAccessibilityMask health_service_metric_averaged_accessible(HealthMetric metric, time_t time_start,
+                                                                         time_t time_end,
+                                                                         HealthServiceTimeScope scope) {
+  return s_steps_average > 0 ? HealthServiceAccessibilityMaskAvailable : HealthServiceAccessibilityMaskNotAvailable;
+}
+
+
+////////////
+// timers //
+////////////
+AppTimer *app_timer_register(uint32_t timeout_ms, AppTimerCallback callback, void *callback_data) {
+  AppTimer *timer = heap_alloc(sizeof(AppTimer));
+  if(timer) {
+    *timer = (AppTimer) { s_now_ms + timeout_ms, callback, callback_data, s_timers };
+    s_timers = timer;
+  }
+  return timer;
+}
+
+
+bool app_timer_reschedule(AppTimer *timer_handle, uint32_t new_timeout_ms) {
+  for(AppTimer *timer = s_timers; timer; timer = timer->next) {
+    if(timer == timer_handle) {
+      timer->due_ms = s_now_ms + new_timeout_ms;
+      return true;
+    }
+  }
+  return false;
+}
+
+
+void app_timer_cancel(AppTimer *timer_handle) {
+  for(AppTimer **link = &s_timers; *link; link = &(*link)->next) {
+    if(*link == timer_handle) {
+      *link = timer_handle->next;
+      heap_free(timer_handle);
+      return;
+    }
+  }
+}
+
+
+void app_event_loop(void) {
+}
+
+
+////////////////
+// appmessage //
+////////////////
+AppMessageResult app_message_open(const uint32_t size_inbound, const uint32_t size_outbound) {
+  return APP_MSG_OK;
+}
+
+
+void app_message_register_inbox_received(AppMessageInboxReceived received_callback) {
+  s_inbox_received = received_callback;
+}
+
+
+void app_message_register_inbox_dropped(AppMessageInboxDropped dropped_callback) {
+  s_inbox_dropped = dropped_callback;
+}
+
+
+void app_message_register_outbox_sent(AppMessageOutboxSent sent_callback) {
+  s_outbox_sent = sent_callback;
+}
+
+
+void app_message_register_outbox_failed(AppMessageOutboxFailed failed_callback) {
+  s_outbox_failed = failed_callback;
+}
+
+
+AppMessageResult app_message_outbox_begin(DictionaryIterator **iterator) {
+  if(!s_connected) {
+    return APP_MSG_NOT_CONNECTED;
+  }
+  if(s_outbox_pending) {
+    return APP_MSG_BUSY;
+  }
+  s_outbox.size = 1;
+  s_outbox.buffer[0] = 0;
+  *iterator = &s_outbox;
+  return APP_MSG_OK;
+}
+
+
+AppMessageResult app_message_outbox_send(void) {
+  if(!s_connected) {
+    return APP_MSG_NOT_CONNECTED;
+  }
+  if(s_outbox_pending) {
+    return APP_MSG_BUSY;
+  }
+  s_outbox_pending = true;
+  s_outbox_due_ms = s_now_ms + OUTBOX_ACK_MS;
+  s_counters.messages_sent++;
+  s_counters.bytes_sent += s_outbox.size;
+  if(s_phone) {
+    s_phone(&s_outbox);
+  }
+  return APP_MSG_OK;
+}
+
+
+uint32_t dict_calc_buffer_size(const uint8_t tuple_count, ...) {
+  uint32_t size = 1 + (tuple_count * TUPLE_HEADER_SIZE);
+  va_list args;
+  va_start(args, tuple_count);
+  for(int i=0; i<tuple_count; i++) {
+    size += va_arg(args, uint32_t);
+  }
+  va_end(args);
+  return size;
+}
+
+
+Tuple *dict_find(const DictionaryIterator *iter, const uint32_t key) {
+  uint16_t offset = 1;
+  for(int i=0; i<iter->buffer[0]; i++) {
+    Tuple *tuple = (Tuple *)&iter->buffer[offset];
+    if(tuple->key == key) {
+      return tuple;
+    }
+    offset += TUPLE_HEADER_SIZE + tuple->length;
+  }
+  return NULL;
+}
+
+
+static DictionaryResult dict_write(DictionaryIterator *iter, uint32_t key, TupleType type, const void *data,
+                                   uint16_t size) {
+  if(iter->size + TUPLE_HEADER_SIZE + size > DICT_BUFFER_SIZE) {
+    return DICT_NOT_ENOUGH_STORAGE;
+  }
+  Tuple *tuple = (Tuple *)&iter->buffer[iter->size];
+  tuple->key = key;
+  tuple->type = type;
+  tuple->length = size;
+  memcpy(tuple->value, data, size);
+  iter->size += TUPLE_HEADER_SIZE + size;
+  iter->buffer[0]++;
+  return DICT_OK;
+}
+
+
+DictionaryResult dict_write_uint8(DictionaryIterator *iter, const uint32_t key, const uint8_t value) {
+  return dict_write(iter, key, TUPLE_UINT, &value, sizeof(value));
+}
+
+
+DictionaryResult dict_write_int32(DictionaryIterator *iter, const uint32_t key, const int32_t value) {
+  return dict_write(iter, key, TUPLE_INT, &value, sizeof(value));
+}
+
+
+DictionaryResult dict_write_data(DictionaryIterator *iter, const uint32_t key, const uint8_t *data,
+                                 const uint16_t size) {
+  return dict_write(iter, key, TUPLE_BYTE_ARRAY, data, size);
+}
+
+
+DictionaryResult dict_write_cstring(DictionaryIterator *iter, const uint32_t key, const char *const cstring) {
+  return dict_write(iter, key, TUPLE_CSTRING, cstring, strlen(cstring) + 1);
+}
+
+
+//////////////////////////
+// fresh watch at `now` //
+//////////////////////////
+void mock_init(time_t now) {
+  // localtime is the watch's local time, keep it the same on every host
+  setenv("TZ", "UTC", 1);
+  tzset();
+  mock_set_time(now);
+
+  s_fb = (GBitmap) {
+    .data = s_fb_data,
+    .format = PBL_IF_COLOR_ELSE(PBL_IF_ROUND_ELSE(GBitmapFormat8BitCircular, GBitmapFormat8Bit), GBitmapFormat1Bit),
+    .size = GSize(PBL_DISPLAY_WIDTH, PBL_DISPLAY_HEIGHT),
+    .bounds = GRect(0, 0, PBL_DISPLAY_WIDTH, PBL_DISPLAY_HEIGHT),
+    .row_size = sizeof(s_fb_data) / PBL_DISPLAY_HEIGHT,
+  };
+  memset(s_fb_data, 0, sizeof(s_fb_data));
+  s_draw = (MockDrawStats) { 0 };
+  s_counters = (MockCounters) { 0 };
+  s_last_tick = now;
+}
+
+
+/////////////////////////////////////////////
+// world events, each wakes the watch once //
+/////////////////////////////////////////////
+void mock_tick(void) {
+  time_t now = mock_time(NULL);
+  struct tm last = *localtime(&s_last_tick);
+  struct tm *tick_time = localtime(&now);
+  TimeUnits units = SECOND_UNIT | MINUTE_UNIT;
+  if(tick_time->tm_hour != last.tm_hour || tick_time->tm_yday != last.tm_yday) {
+    units |= HOUR_UNIT;
+  }
+  if(tick_time->tm_yday != last.tm_yday) {
+    units |= DAY_UNIT;
+  }
+  s_last_tick = now;
+
+  if(s_tick_handler) {
+    s_counters.wakeups++;
+    s_tick_handler(tick_time, units);
+    mock_render();
+  }
+}
+
+
+void mock_set_battery(BatteryChargeState state) {
+  s_battery = state;
+  if(s_battery_handler) {
+    s_counters.wakeups++;
+    s_battery_handler(state);
+    mock_render();
+  }
+}
+
+
+void mock_tap(void) {
+  if(s_tap_handler) {
+    s_counters.wakeups++;
+    s_tap_handler(ACCEL_AXIS_Z, 1);
+    mock_render();
+  }
+}
+
+
+void mock_set_connected(bool connected) {
+  if(connected == s_connected) {
+    return;
+  }
+  s_connected = connected;
+  if(s_connection_handler) {
+    s_counters.wakeups++;
+    s_connection_handler(connected);
+    mock_render();
+  }
+}
+
+
+void mock_set_steps(HealthValue steps) {
+  // a lower count is a new day, which the service reports as significant
+  HealthEventType event = steps < s_steps ? HealthEventSignificantUpdate : HealthEventMovementUpdate;
+  s_steps = steps;
+  if(s_health_handler) {
+    s_counters.wakeups++;
+    s_health_handler(event, NULL);
+    mock_render();
+  }
+}
+
+
+DictionaryIterator *mock_inbox_begin(void) {
+  s_inbox.size = 1;
+  s_inbox.buffer[0] = 0;
+  return &s_inbox;
+}
+
+
+void mock_inbox_send(void) {
+  s_counters.messages_received++;
+  s_counters.bytes_received += s_inbox.size;
+  if(s_inbox_received) {
+    s_counters.wakeups++;
+    s_inbox_received(&s_inbox, NULL);
+    mock_render();
+  }
+}
+
+
+void mock_set_phone(MockPhoneHandler handler) {
+  s_phone = handler;
+}
+
+
+///////////////////////////////////////
+// timers and acks, in the order due //
+///////////////////////////////////////
+uint64_t mock_now_ms(void) {
+  return s_now_ms;
+}
+
+
+uint64_t mock_next_event_ms(void) {
+  uint64_t next = s_outbox_pending ? s_outbox_due_ms : UINT64_MAX;
+  for(AppTimer *timer = s_timers; timer; timer = timer->next) {
+    next = MIN(next, timer->due_ms);
+  }
+  return next;
+}
+
+
+void mock_run_until(uint64_t ms) {
+  for(;;) {
+    uint64_t next = mock_next_event_ms();
+    if(next > ms) {
+      break;
+    }
+    s_now_ms = MAX(s_now_ms, next);
+    s_counters.wakeups++;
+
+    if(s_outbox_pending && s_outbox_due_ms == next) {
+      s_outbox_pending = false;
+      if(s_connected && s_outbox_sent) {
+        s_outbox_sent(&s_outbox, NULL);
+      } else if(!s_connected && s_outbox_failed) {
+        s_outbox_failed(&s_outbox, APP_MSG_SEND_TIMEOUT, NULL);
+      }
+    } else {
+      AppTimer *timer = s_timers;
+      for(AppTimer *t = s_timers; t; t = t->next) {
+        if(t->due_ms < timer->due_ms) {
+          timer = t;
+        }
+      }
+      AppTimerCallback callback = timer->callback;
+      void *data = timer->data;
+      app_timer_cancel(timer);
+      callback(data);
+    }
+    mock_render();
+  }
+  s_now_ms = MAX(s_now_ms, ms);
+}
+
+
+const MockCounters *mock_counters(void) {
+  return &s_counters;
+}
@@ -0,0 +1,88 @@
+// Harness side of the host mock: frame buffer access, draw counters and
+// control over the simulated clock. The watchface only sees pebble.h.
+
+
+#pragma once
+
+#include <pebble.h>
+
+
+///////////////////
+// draw counters //
+///////////////////
+typedef struct MockDrawStats {
+  uint32_t draw_calls; // graphics_draw_*, graphics_fill_* and blits
+  uint32_t stroke_pixels; // pixels written by lines and outlines
+  uint32_t fills; // fill calls
+  uint32_t fill_pixels; // pixels written by fills
+  uint32_t blit_pixels; // pixels written by bitmaps
+  uint32_t text_pixels; // pixels written by text
+} MockDrawStats;
+
+// what a stretch of simulated time cost, see replay.c
+typedef struct MockCounters {
+  uint32_t wakeups; // handlers, timers and message callbacks run
+  uint32_t invalidations; // layer_mark_dirty and setters that need a redraw
+  uint32_t frames; // frames rendered
+  uint64_t frame_pixels; // pixels written while rendering them
+  uint32_t flash_writes;
+  uint32_t flash_bytes;
+  uint32_t bitmap_allocs;
+  uint32_t bitmap_bytes;
+  uint32_t messages_sent;
+  uint32_t bytes_sent;
+  uint32_t messages_received;
+  uint32_t bytes_received;
+  uint32_t vibes;
+} MockCounters;
+
+// sees every message the watch sends, to play the phone
+typedef void (*MockPhoneHandler)(DictionaryIterator *iterator);
+
+// icon images, generated from resources/images by gen_headers.py
+typedef struct MockImage {
+  uint32_t resource_id;
+  int16_t width;
+  int16_t height;
+  const uint8_t *mask; // 1 where the icon is drawn, a byte per pixel
+} MockImage;
+
+extern const MockImage mock_images[];
+extern const int mock_image_count;
+
+void mock_init(time_t now);
+void mock_set_time(time_t now);
+
+// context drawing straight into the frame buffer, for calling update procs
+GContext *mock_context(void);
+GBitmap *mock_framebuffer(void);
+
+// hash of what is on screen, and the same written out as a PPM image
+uint32_t mock_framebuffer_hash(void);
+bool mock_framebuffer_write_ppm(const char *path);
+
+// draw the pushed window like the system does, if anything is dirty
+bool mock_render(void);
+
+// counters since the last call, then reset
+MockDrawStats mock_draw_stats_take(void);
+
+// nanoseconds from a monotonic clock, for timing procs
+uint64_t mock_now_ns(void);
+
+// events from outside, each one runs its handler and renders
+void mock_tick(void);
+void mock_set_battery(BatteryChargeState state);
+void mock_set_connected(bool connected);
+void mock_tap(void);
+void mock_set_steps(HealthValue steps);
+DictionaryIterator *mock_inbox_begin(void);
+void mock_inbox_send(void);
+void mock_set_phone(MockPhoneHandler handler);
+
+// app timers and outbox acks: when the next is due, and run them up to ms
+uint64_t mock_now_ms(void);
+uint64_t mock_next_event_ms(void);
+void mock_run_until(uint64_t ms);
+
+const MockCounters *mock_counters(void);
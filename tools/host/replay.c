@@ -0,0 +1,440 @@
+// Energy model for the watchface on the host. Replays 24 hours of events,
+// minute ticks, battery and charging changes, Bluetooth drops, step
+// updates, settings from Clay and the phone answering weather requests,
+// through the real handlers and the mock layer tree. Counts what the
+// watch does in that time, wakeups, redraws and the pixels they write,
+// flash writes, bitmap allocations and AppMessage traffic, and weighs
+// them with rough per event costs.
+//
+// The costs are estimates, not measurements, and only meant for
+// comparing two builds or two traces against each other. They are only
+// what the events add: idle and stop-mode current, the larger part of a
+// real day, is not modelled, so the total says nothing about battery
+// life.
+//
+// usage: replay [--print-trace | TRACE]
+//   TRACE is a file of "HH:MM[:SS] event args" lines, sorted by time:
+//     battery PERCENT [charging|plugged]
+//     connected 0|1
+//     steps COUNT
+//     weather TEMP_F CONDITION    what the phone answers from then on,
+//                                 a name from conditions.json in lower case
+//     invert 0|1                  Clay settings, sent as one message
+//     celsius 0|1
+//   without one a built in day is replayed, --print-trace writes it out
+
+
+#include <pebble.h>
+#include "mock.h"
+#include "weather_condition_names.h"
+
+#define main watchface_main
+#include "watchface.c"
+#undef main
+
+
+#define REPLAY_START 1704067200 // Monday 1 January 2024, 00:00 UTC
+#define REPLAY_SECONDS (24 * 60 * 60)
+#define REPLAY_MAX_EVENTS 2048
+#define PHONE_REPLY_MS 4000 // PebbleKit JS fetching weather over the network
+
+// Rough costs in microjoules unless noted. None is measured on a Pebble
+// or taken from a datasheet. Each is an assumed current and duration at
+// 3.7 V, written next to it so it can be replaced with a measurement.
+#define ENERGY_WAKEUP 15.0 // 4 mA CPU for 1 ms, leaving stop mode to run one handler
+#define ENERGY_FRAME 40.0 // 0.5 mA for 20 ms, pushing a frame to the display
+#define ENERGY_PIXEL_NJ 4.0 // 4 mA for 0.27 us, each pixel written while drawing
+#define ENERGY_FLASH_WRITE 300.0 // 4 mA for 20 ms, erase and program a persist entry
+#define ENERGY_FLASH_BYTE 1.0 // 4 mA for 70 us per byte programmed
+#define ENERGY_BITMAP_ALLOC 2.0 // 4 mA for 0.1 ms, a heap walk
+#define ENERGY_MESSAGE 1500.0 // 10 mA of radio for 40 ms, connection events for one message
+#define ENERGY_MESSAGE_BYTE 5.0 // 10 mA of radio for 0.1 ms per byte
+#define ENERGY_VIBE 40000.0 // 100 mA motor for 100 ms
+
+typedef enum ReplayKind {
+  REPLAY_BATTERY,
+  REPLAY_CONNECTED,
+  REPLAY_STEPS,
+  REPLAY_WEATHER,
+  REPLAY_INVERT,
+  REPLAY_CELSIUS,
+} ReplayKind;
+
+typedef struct ReplayEvent {
+  uint32_t at; // seconds into the day
+  ReplayKind kind;
+  int32_t value;
+  int32_t extra; // charging for battery, condition for weather
+} ReplayEvent;
+
+static ReplayEvent s_events[REPLAY_MAX_EVENTS];
+static int s_event_count;
+
+// phone side: current conditions and whether a reply is on its way
+static int16_t s_phone_temp_f = 55;
+static WeatherCondition s_phone_condition = WEATHER_CONDITION_CLEAR_SKY_NIGHT;
+static bool s_phone_connected = true;
+static bool s_phone_busy;
+static uint64_t s_phone_reply_ms;
+static uint32_t s_phone_requests;
+
+
+////////////////////////////
+// trace in and trace out //
+////////////////////////////
+static void event_add(uint32_t at, ReplayKind kind, int32_t value, int32_t extra) {
+  if(s_event_count == REPLAY_MAX_EVENTS) {
+    fprintf(stderr, "replay: more than %d events\n", REPLAY_MAX_EVENTS);
+    exit(1);
+  }
+  s_events[s_event_count++] = (ReplayEvent) { .at = at, .kind = kind, .value = value, .extra = extra };
+}
+
+
+static const char *condition_name(int32_t condition) {
+  if(condition < 0 || condition >= WEATHER_CONDITION_COUNT) {
+    return WEATHER_CONDITION_NAMES[WEATHER_CONDITION_UNKNOWN];
+  }
+  return WEATHER_CONDITION_NAMES[condition];
+}
+
+
+static bool trace_load(const char *path) {
+  FILE *file = fopen(path, "r");
+  if(!file) {
+    perror(path);
+    return false;
+  }
+
+  char line[128];
+  int line_number = 0;
+  while(fgets(line, sizeof(line), file)) {
+    line_number++;
+    if(line[0] == '#' || line[0] == '\n') {
+      continue;
+    }
+
+    unsigned int hours, minutes, seconds = 0;
+    char kind[16], arg[24] = "";
+    int value = 0, used = 0;
+    if(sscanf(line, "%u:%u%n", &hours, &minutes, &used) != 2 ||
+       (line[used] == ':' && sscanf(line + used, ":%u", &seconds) != 1) ||
+       sscanf(line, "%*s %15s %d %23s", kind, &value, arg) < 2) {
+      fprintf(stderr, "%s:%d: bad line\n", path, line_number);
+      fclose(file);
+      return false;
+    }
+
+    uint32_t at = (hours * 60 + minutes) * 60 + seconds;
+    if(strcmp(kind, "battery") == 0) {
+      event_add(at, REPLAY_BATTERY, value, strcmp(arg, "charging") == 0 ? 2 : strcmp(arg, "plugged") == 0 ? 1 : 0);
+    } else if(strcmp(kind, "connected") == 0) {
+      event_add(at, REPLAY_CONNECTED, value, 0);
+    } else if(strcmp(kind, "steps") == 0) {
+      event_add(at, REPLAY_STEPS, value, 0);
+    } else if(strcmp(kind, "weather") == 0) {
+      int32_t condition = WEATHER_CONDITION_UNKNOWN;
+      for(int i=0; i<WEATHER_CONDITION_COUNT; i++) {
+        if(strcmp(arg, WEATHER_CONDITION_NAMES[i]) == 0) {
+          condition = i;
+        }
+      }
+      event_add(at, REPLAY_WEATHER, value, condition);
+    } else if(strcmp(kind, "invert") == 0) {
+      event_add(at, REPLAY_INVERT, value, 0);
+    } else if(strcmp(kind, "celsius") == 0) {
+      event_add(at, REPLAY_CELSIUS, value, 0);
+    } else {
+      fprintf(stderr, "%s:%d: unknown event %s\n", path, line_number, kind);
+      fclose(file);
+      return false;
+    }
+  }
+
+  fclose(file);
+  return true;
+}
+
+
+static void trace_print(void) {
+  static const char *kinds[] = { "battery", "connected", "steps", "weather", "invert", "celsius" };
+  for(int i=0; i<s_event_count; i++) {
+    const ReplayEvent *event = &s_events[i];
+    printf("%02u:%02u:%02u %s %d", (unsigned)(event->at / 3600), (unsigned)(event->at / 60 % 60),
+           (unsigned)(event->at % 60), kinds[event->kind], (int)event->value);
+    if(event->kind == REPLAY_BATTERY && event->extra) {
+      printf(event->extra == 2 ? " charging" : " plugged");
+    } else if(event->kind == REPLAY_WEATHER) {
+      printf(" %s", condition_name(event->extra));
+    }
+    printf("\n");
+  }
+}
+
+
+//////////////////////////////////////////////////////////
+// a plain weekday: walks, a dropout, charging at night //
+//////////////////////////////////////////////////////////
+static void trace_synthetic(void) {
+  #define HM(h, m) (((h) * 60 + (m)) * 60)
+
+  event_add(HM(0, 0), REPLAY_BATTERY, 90, 0);
+  event_add(HM(0, 0), REPLAY_WEATHER, 52, WEATHER_CONDITION_CLEAR_SKY_NIGHT);
+
+  // short dropout overnight, phone moved out of range
+  event_add(HM(2, 10), REPLAY_CONNECTED, 0, 0);
+  event_add(HM(2, 20), REPLAY_CONNECTED, 1, 0);
+  event_add(HM(5, 0), REPLAY_BATTERY, 80, 0);
+
+  // steps arrive each minute while walking and every few otherwise
+  uint32_t steps = 0, seed = 1;
+  for(int minute=7 * 60; minute<22 * 60; minute++) {
+    bool walking = (minute >= 7 * 60 + 30 && minute < 8 * 60 + 15) ||
+                   (minute >= 12 * 60 && minute < 12 * 60 + 40) ||
+                   (minute >= 17 * 60 + 30 && minute < 18 * 60 + 30);
+    seed = seed * 1103515245 + 12345;
+    if(walking) {
+      steps += 90 + (seed >> 16) % 30;
+      event_add(minute * 60 + 20, REPLAY_STEPS, steps, 0);
+    } else if(minute % 5 == 0) {
+      steps += (seed >> 16) % 40;
+      event_add(minute * 60 + 20, REPLAY_STEPS, steps, 0);
+    }
+
+    if(minute == 7 * 60) {
+      event_add(HM(7, 0), REPLAY_WEATHER, 56, WEATHER_CONDITION_CLEAR_SKY_DAY);
+    } else if(minute == 9 * 60 + 30) {
+      // Clay resends every setting when the page is saved, none changed
+      event_add(HM(9, 30), REPLAY_INVERT, 0, 0);
+      event_add(HM(9, 30), REPLAY_CELSIUS, 0, 0);
+    } else if(minute == 11 * 60) {
+      event_add(HM(11, 0), REPLAY_BATTERY, 70, 0);
+    } else if(minute == 12 * 60) {
+      event_add(HM(12, 0), REPLAY_WEATHER, 64, WEATHER_CONDITION_PARTLY_CLOUDY_DAY);
+    } else if(minute == 14 * 60) {
+      // phone left on a desk for most of an hour
+      event_add(HM(14, 0), REPLAY_CONNECTED, 0, 0);
+    } else if(minute == 14 * 60 + 45) {
+      event_add(HM(14, 45), REPLAY_CONNECTED, 1, 0);
+    } else if(minute == 16 * 60) {
+      event_add(HM(16, 0), REPLAY_WEATHER, 61, WEATHER_CONDITION_RAIN);
+    } else if(minute == 17 * 60) {
+      event_add(HM(17, 0), REPLAY_BATTERY, 60, 0);
+    } else if(minute == 20 * 60) {
+      event_add(HM(20, 0), REPLAY_WEATHER, 57, WEATHER_CONDITION_CLOUDY);
+    } else if(minute == 20 * 60 + 30) {
+      event_add(HM(20, 30), REPLAY_INVERT, 1, 0);
+      event_add(HM(20, 30), REPLAY_CELSIUS, 0, 0);
+    }
+  }
+
+  event_add(HM(22, 0), REPLAY_BATTERY, 60, 2);
+  event_add(HM(22, 30), REPLAY_BATTERY, 80, 2);
+  event_add(HM(23, 0), REPLAY_BATTERY, 100, 1);
+  event_add(HM(23, 15), REPLAY_BATTERY, 100, 0);
+
+  // events were added by minute, steps went in ahead of same minute events
+  for(int i=1; i<s_event_count; i++) {
+    ReplayEvent event = s_events[i];
+    int j = i;
+    while(j > 0 && s_events[j - 1].at > event.at) {
+      s_events[j] = s_events[j - 1];
+      j--;
+    }
+    s_events[j] = event;
+  }
+
+  #undef HM
+}
+
+
+/////////////////////////////////////////////////
+// phone: answers weather requests a bit later //
+/////////////////////////////////////////////////
+static void phone_outbox(DictionaryIterator *iterator) {
+  if(dict_find(iterator, MESSAGE_KEY_KEY_REQUEST_WEATHER) && !s_phone_busy) {
+    s_phone_busy = true;
+    s_phone_reply_ms = mock_now_ms() + PHONE_REPLY_MS;
+    s_phone_requests++;
+  }
+}
+
+
+static void phone_reply(void) {
+  // the reply is lost if the watch went out of range meanwhile
+  s_phone_busy = false;
+  if(!s_phone_connected) {
+    return;
+  }
+  time_t now = mock_time(NULL);
+
+  WeatherPayload weather = {
+    .version = WEATHER_PAYLOAD_VERSION,
+    .condition = s_phone_condition,
+    .temp_f = s_phone_temp_f,
+    .temp_c = (s_phone_temp_f - 32) * 5 / 9,
+    .observed = now,
+  };
+
+  // hourly forecast holding the current conditions, like a steady day
+  ForecastPayload forecast = {
+    .version = FORECAST_PAYLOAD_VERSION,
+    .count = FORECAST_MAX_ENTRIES,
+    .step = 60,
+    .start = now - (now % SECONDS_PER_HOUR) + SECONDS_PER_HOUR,
+  };
+  for(int i=0; i<FORECAST_MAX_ENTRIES; i++) {
+    forecast.entries[i] = (ForecastEntry) { s_phone_condition, weather.temp_f, weather.temp_c };
+  }
+
+  DictionaryIterator *iterator = mock_inbox_begin();
+  dict_write_data(iterator, MESSAGE_KEY_KEY_WEATHER, (const uint8_t *)&weather, sizeof(weather));
+  dict_write_data(iterator, MESSAGE_KEY_KEY_FORECAST, (const uint8_t *)&forecast, sizeof(forecast));
+  mock_inbox_send();
+}
+
+
+//////////////////////////////
+// one trace event, now due //
+//////////////////////////////
+static void event_run(const ReplayEvent *event) {
+  switch(event->kind) {
+    case REPLAY_BATTERY:
+      mock_set_battery((BatteryChargeState) {
+        .charge_percent = event->value,
+        .is_charging = event->extra == 2,
+        .is_plugged = event->extra != 0,
+      });
+      break;
+    case REPLAY_CONNECTED:
+      s_phone_connected = event->value;
+      mock_set_connected(event->value);
+      break;
+    case REPLAY_STEPS:
+      mock_set_steps(event->value);
+      break;
+    case REPLAY_WEATHER:
+      s_phone_temp_f = event->value;
+      s_phone_condition = event->extra;
+      break;
+    case REPLAY_INVERT:
+    case REPLAY_CELSIUS: {
+      // Clay sends both settings together, pick up the partner event
+      static DictionaryIterator *s_settings;
+      if(!s_settings) {
+        s_settings = mock_inbox_begin();
+      }
+      dict_write_int32(s_settings, event->kind == REPLAY_INVERT ? MESSAGE_KEY_KEY_INVERT_COLORS : MESSAGE_KEY_KEY_TEMP_UNIT,
+                       event->value);
+      const ReplayEvent *next = event + 1;
+      if(next == s_events + s_event_count || next->at != event->at ||
+         (next->kind != REPLAY_INVERT && next->kind != REPLAY_CELSIUS)) {
+        mock_inbox_send();
+        s_settings = NULL;
+      }
+      break;
+    }
+  }
+}
+
+
+//////////////////////////////////////////////
+// merge ticks, trace, timers and the phone //
+//////////////////////////////////////////////
+static void replay_day(void) {
+  uint64_t start_ms = mock_now_ms();
+  uint64_t end_ms = start_ms + (uint64_t)REPLAY_SECONDS * 1000;
+  uint64_t next_tick_ms = start_ms + 60 * 1000;
+  int next_event = 0;
+
+  for(;;) {
+    uint64_t event_ms = next_event < s_event_count ? start_ms + (uint64_t)s_events[next_event].at * 1000 : UINT64_MAX;
+    uint64_t phone_ms = s_phone_busy ? s_phone_reply_ms : UINT64_MAX;
+    uint64_t next_ms = MIN(MIN(next_tick_ms, event_ms), MIN(phone_ms, mock_next_event_ms()));
+    if(next_ms > end_ms) {
+      break;
+    }
+
+    // app timers and outbox acks due by then run first
+    mock_run_until(next_ms);
+
+    if(event_ms == next_ms) {
+      event_run(&s_events[next_event++]);
+    } else if(phone_ms == next_ms) {
+      phone_reply();
+    } else if(next_tick_ms == next_ms) {
+      mock_tick();
+      next_tick_ms += 60 * 1000;
+    }
+  }
+  mock_run_until(end_ms);
+}
+
+
+//////////////////////////////////
+// one row of the energy report //
+//////////////////////////////////
+static double report_row(const char *name, uint64_t count, const char *unit, uint64_t extra, double uj) {
+  char detail[32] = "";
+  if(unit) {
+    snprintf(detail, sizeof(detail), "%llu %s", (unsigned long long)extra, unit);
+  }
+  printf("%-20s %10llu %-16s %10.1f\n", name, (unsigned long long)count, detail, uj / 1000.0);
+  return uj;
+}
+
+
+static void report(void) {
+  const MockCounters *counters = mock_counters();
+  WeatherSchedulerStats weather = weather_scheduler_get_stats();
+
+  printf("\n%-20s %10s %-16s %10s\n", "", "count", "", "mJ");
+  double total = 0;
+  total += report_row("wakeups", counters->wakeups, NULL, 0, counters->wakeups * ENERGY_WAKEUP);
+  report_row("invalidations", counters->invalidations, NULL, 0, 0);
+  total += report_row("frames", counters->frames, NULL, 0, counters->frames * ENERGY_FRAME);
+  total += report_row("pixels drawn", counters->frame_pixels, NULL, 0, counters->frame_pixels * ENERGY_PIXEL_NJ / 1000.0);
+  total += report_row("flash writes", counters->flash_writes, "bytes", counters->flash_bytes,
+                      counters->flash_writes * ENERGY_FLASH_WRITE + counters->flash_bytes * ENERGY_FLASH_BYTE);
+  total += report_row("bitmap allocations", counters->bitmap_allocs, "bytes", counters->bitmap_bytes,
+                      counters->bitmap_allocs * ENERGY_BITMAP_ALLOC);
+  total += report_row("messages sent", counters->messages_sent, "bytes", counters->bytes_sent,
+                      counters->messages_sent * ENERGY_MESSAGE + counters->bytes_sent * ENERGY_MESSAGE_BYTE);
+  total += report_row("messages received", counters->messages_received, "bytes", counters->bytes_received,
+                      counters->messages_received * ENERGY_MESSAGE + counters->bytes_received * ENERGY_MESSAGE_BYTE);
+  total += report_row("vibrations", counters->vibes, NULL, 0, counters->vibes * ENERGY_VIBE);
+  printf("%-20s %10s %-16s %10.1f  events only, no idle current\n", "total", "", "", total / 1000.0);
+
+  printf("\nweather requests %u sent, %u suppressed, %u failed, %u answered by the phone\n",
+         (unsigned)weather.sent, (unsigned)weather.suppressed, (unsigned)weather.failed, (unsigned)s_phone_requests);
+}
+
+
+int main(int argc, char **argv) {
+  if(argc > 1 && strcmp(argv[1], "--print-trace") == 0) {
+    trace_synthetic();
+    trace_print();
+    return 0;
+  }
+  if(argc > 1) {
+    if(!trace_load(argv[1])) {
+      return 1;
+    }
+  } else {
+    trace_synthetic();
+  }
+
+  mock_init(REPLAY_START);
+  mock_set_phone(phone_outbox);
+  init();
+  mock_render();
+
+  printf("%s %dx%d, 24 hours, %d trace events, PARTIAL_REDRAW %d, SINGLE_LAYER %d\n",
+         PBL_IF_ROUND_ELSE("round", "rect"), PBL_DISPLAY_WIDTH, PBL_DISPLAY_HEIGHT, s_event_count,
+         PARTIAL_REDRAW, SINGLE_LAYER);
+  replay_day();
+  report();
+
+  deinit();
+  return 0;
+}
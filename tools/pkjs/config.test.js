@@ -0,0 +1,34 @@
+// src/pkjs/config.js against what the watch expects from it: every
+// setting is a known message key, and the inbox is sized for all of them.
+var test = require('node:test');
+var assert = require('node:assert');
+var fs = require('fs');
+var path = require('path');
+var config = require('../../src/pkjs/config');
+var pkg = require('../../package.json');
+
+function messageKeys(items) {
+  var keys = [];
+  items.forEach(function (item) {
+    if (item.messageKey) {
+      keys.push(item.messageKey);
+    }
+    if (item.items) {
+      keys = keys.concat(messageKeys(item.items));
+    }
+  });
+  return keys;
+}
+
+test('every setting has a message key in package.json', function () {
+  messageKeys(config).forEach(function (key) {
+    assert.ok(pkg.pebble.messageKeys.indexOf(key) >= 0, key + ' missing from package.json');
+  });
+});
+
+test('SETTINGS_MESSAGE_KEYS matches the settings Clay sends', function () {
+  var header = fs.readFileSync(path.join(__dirname, '../../src/c/watchface.h'), 'utf8');
+  var match = /#define SETTINGS_MESSAGE_KEYS (\d+)/.exec(header);
+  assert.ok(match, 'SETTINGS_MESSAGE_KEYS not found in watchface.h');
+  assert.strictEqual(parseInt(match[1], 10), messageKeys(config).length);
+});
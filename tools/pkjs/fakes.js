@@ -0,0 +1,67 @@
+// Stand-ins for the phone globals the pkjs modules are handed, so they
+// run under node. Nothing here goes near the network.
+
+// localStorage over a Map, values come back as strings like the real one
+function createStorage() {
+  var items = new Map();
+  return {
+    getItem: function (key) {
+      return items.has(key) ? items.get(key) : null;
+    },
+    setItem: function (key, value) {
+      items.set(key, String(value));
+    },
+    removeItem: function (key) {
+      items.delete(key);
+    }
+  };
+}
+
+// XMLHttpRequest class whose answers come from routes(url), which returns
+// { status, body } to answer, or null to leave the request hanging.
+// Every request made is kept in .requests for the test to count.
+function createXHR(routes) {
+  function FakeXHR() {
+    this.status = 0;
+    this.responseText = '';
+    this.aborted = false;
+    FakeXHR.requests.push(this);
+  }
+  FakeXHR.requests = [];
+
+  FakeXHR.prototype.open = function (method, url) {
+    this.method = method;
+    this.url = url;
+  };
+
+  FakeXHR.prototype.send = function () {
+    var xhr = this;
+    var answer = routes(xhr.url);
+    if (!answer) {
+      return;
+    }
+    setTimeout(function () {
+      if (xhr.aborted) {
+        return;
+      }
+      if (answer.networkError) {
+        xhr.onerror();
+        return;
+      }
+      xhr.status = answer.status;
+      xhr.responseText = typeof answer.body === 'string' ? answer.body : JSON.stringify(answer.body);
+      xhr.onload();
+    }, 0);
+  };
+
+  FakeXHR.prototype.abort = function () {
+    this.aborted = true;
+  };
+
+  return FakeXHR;
+}
+
+module.exports = {
+  createStorage: createStorage,
+  createXHR: createXHR
+};
@@ -0,0 +1,133 @@
+// src/pkjs/fetch.js against a fake XMLHttpRequest: shared requests,
+// the response cache, timeouts and errors.
+var test = require('node:test');
+var assert = require('node:assert');
+var fakes = require('./fakes');
+var fetch = require('../../src/pkjs/fetch');
+
+var URL = 'http://weather.test/now';
+
+function getJson(fetcher, url, cacheKey) {
+  return new Promise(function (resolve) {
+    fetcher.getJson(url, cacheKey, function (err, json, cached) {
+      resolve({ err: err, json: json, cached: cached });
+    });
+  });
+}
+
+test('overlapping requests for one url share a request', async function () {
+  var XHR = fakes.createXHR(function () {
+    return { status: 200, body: { temp: 64 } };
+  });
+  var fetcher = fetch.createFetcher({ XMLHttpRequest: XHR, storage: fakes.createStorage() });
+
+  var results = await Promise.all([getJson(fetcher, URL, null), getJson(fetcher, URL, null),
+                                   getJson(fetcher, URL + '?other', null)]);
+  assert.strictEqual(XHR.requests.length, 2);
+  results.forEach(function (result) {
+    assert.ifError(result.err);
+    assert.deepStrictEqual(result.json, { temp: 64 });
+  });
+
+  // once answered, the next one goes out again
+  await getJson(fetcher, URL, null);
+  assert.strictEqual(XHR.requests.length, 3);
+});
+
+test('cached response is used inside the ttl and refetched after it', async function (t) {
+  var now = 1000000;
+  t.mock.method(Date, 'now', function () {
+    return now;
+  });
+  var temp = 64;
+  var XHR = fakes.createXHR(function () {
+    return { status: 200, body: { temp: temp } };
+  });
+  var fetcher = fetch.createFetcher({ XMLHttpRequest: XHR, storage: fakes.createStorage(), ttl: 60000 });
+
+  var first = await getJson(fetcher, URL, 'now');
+  assert.strictEqual(first.cached, undefined);
+  assert.deepStrictEqual(first.json, { temp: 64 });
+
+  temp = 70;
+  now += 59999;
+  var hit = await getJson(fetcher, URL, 'now');
+  assert.strictEqual(hit.cached, true);
+  assert.deepStrictEqual(hit.json, { temp: 64 });
+  assert.strictEqual(XHR.requests.length, 1);
+
+  now += 1;
+  var expired = await getJson(fetcher, URL, 'now');
+  assert.ok(!expired.cached);
+  assert.deepStrictEqual(expired.json, { temp: 70 });
+  assert.strictEqual(XHR.requests.length, 2);
+});
+
+test('unreadable cache entry is dropped and refetched', async function () {
+  var storage = fakes.createStorage();
+  storage.setItem('now', '{not json');
+  var XHR = fakes.createXHR(function () {
+    return { status: 200, body: { temp: 64 } };
+  });
+  var fetcher = fetch.createFetcher({ XMLHttpRequest: XHR, storage: storage, ttl: 60000 });
+
+  var result = await getJson(fetcher, URL, 'now');
+  assert.ifError(result.err);
+  assert.strictEqual(XHR.requests.length, 1);
+  assert.deepStrictEqual(JSON.parse(storage.getItem('now')).json, { temp: 64 });
+});
+
+test('request that never answers times out and is aborted', async function () {
+  var XHR = fakes.createXHR(function () {
+    return null;
+  });
+  var fetcher = fetch.createFetcher({ XMLHttpRequest: XHR, storage: fakes.createStorage(), timeout: 20 });
+
+  var results = await Promise.all([getJson(fetcher, URL, null), getJson(fetcher, URL, null)]);
+  results.forEach(function (result) {
+    assert.match(result.err.message, /^timeout after 20ms/);
+  });
+  assert.strictEqual(XHR.requests.length, 1);
+  assert.strictEqual(XHR.requests[0].aborted, true);
+});
+
+test('malformed JSON is an error and is not cached', async function () {
+  var storage = fakes.createStorage();
+  var XHR = fakes.createXHR(function () {
+    return { status: 200, body: '{"temp": ' };
+  });
+  var fetcher = fetch.createFetcher({ XMLHttpRequest: XHR, storage: storage, ttl: 60000 });
+
+  var result = await getJson(fetcher, URL, 'now');
+  assert.match(result.err.message, /^bad JSON: /);
+  assert.strictEqual(storage.getItem('now'), null);
+});
+
+test('HTTP status is passed on with the error', async function () {
+  var status = 429;
+  var XHR = fakes.createXHR(function () {
+    return { status: status, body: { message: 'slow down' } };
+  });
+  var fetcher = fetch.createFetcher({ XMLHttpRequest: XHR, storage: fakes.createStorage() });
+
+  var result = await getJson(fetcher, URL, null);
+  assert.strictEqual(result.err.message, 'HTTP 429');
+  assert.strictEqual(result.err.status, 429);
+
+  status = 500;
+  result = await getJson(fetcher, URL, null);
+  assert.strictEqual(result.err.status, 500);
+});
+
+test('network error reaches every caller', async function () {
+  var XHR = fakes.createXHR(function () {
+    return { networkError: true };
+  });
+  var fetcher = fetch.createFetcher({ XMLHttpRequest: XHR, storage: fakes.createStorage() });
+
+  var results = await Promise.all([getJson(fetcher, URL, null), getJson(fetcher, URL, null)]);
+  results.forEach(function (result) {
+    assert.strictEqual(result.err.message, 'network error');
+    assert.strictEqual(result.err.status, undefined);
+  });
+});
@@ -0,0 +1,96 @@
+// src/pkjs/location.js against a fake navigator.geolocation: reusing a
+// recent fix, the cheap fix before the expensive one, and staying on the
+// stored spot.
+var test = require('node:test');
+var assert = require('node:assert');
+var fakes = require('./fakes');
+var geo = require('../../src/pkjs/location');
+
+var HOME = { latitude: 52.52, longitude: 13.4 };
+var NEARBY = { latitude: 52.521, longitude: 13.401 };
+var ELSEWHERE = { latitude: 48.85, longitude: 2.35 };
+var HOUR_MS = 60 * 60 * 1000;
+
+// answers(options) returns coords for a fix, or null for it to fail
+function createGeolocation(answers) {
+  var geolocation = { requests: [] };
+  geolocation.getCurrentPosition = function (success, failure, options) {
+    geolocation.requests.push(options);
+    var coords = answers(options);
+    setTimeout(function () {
+      if (coords) {
+        success({ coords: coords });
+      } else {
+        failure(new Error('timeout'));
+      }
+    }, 0);
+  };
+  return geolocation;
+}
+
+function locate(geolocation, storage) {
+  var locator = geo.createLocator({ geolocation: geolocation, storage: storage, maxDistanceKm: 1, maxAgeMs: HOUR_MS });
+  return new Promise(function (resolve) {
+    locator.locate(function (err, pos) {
+      resolve({ err: err, coords: pos && pos.coords });
+    });
+  });
+}
+
+function storageAt(coords, at) {
+  var storage = fakes.createStorage();
+  storage.setItem('lastLocation', JSON.stringify({ at: at, coords: coords }));
+  return storage;
+}
+
+test.beforeEach(function (t) {
+  t.mock.method(console, 'log', function () {});
+});
+
+test('recent fix is reused without asking for a new one', async function () {
+  var geolocation = createGeolocation(function () {
+    return ELSEWHERE;
+  });
+  var result = await locate(geolocation, storageAt(HOME, Date.now() - 60000));
+  assert.deepStrictEqual(result.coords, HOME);
+  assert.strictEqual(geolocation.requests.length, 0);
+});
+
+test('old fix asks for a cheap one and keeps the spot if close', async function () {
+  var storage = storageAt(HOME, Date.now() - 2 * HOUR_MS);
+  var geolocation = createGeolocation(function () {
+    return NEARBY;
+  });
+  var result = await locate(geolocation, storage);
+  assert.deepStrictEqual(result.coords, HOME);
+  assert.strictEqual(geolocation.requests.length, 1);
+  assert.strictEqual(geolocation.requests[0].enableHighAccuracy, false);
+  assert.ok(Date.now() - JSON.parse(storage.getItem('lastLocation')).at < 1000);
+});
+
+test('old fix is dropped when the phone has moved', async function () {
+  var storage = storageAt(HOME, Date.now() - 2 * HOUR_MS);
+  var result = await locate(createGeolocation(function () {
+    return ELSEWHERE;
+  }), storage);
+  assert.deepStrictEqual(result.coords, ELSEWHERE);
+  assert.deepStrictEqual(JSON.parse(storage.getItem('lastLocation')).coords, ELSEWHERE);
+});
+
+test('old fix falls through to high accuracy', async function () {
+  var geolocation = createGeolocation(function (options) {
+    return options.enableHighAccuracy ? NEARBY : null;
+  });
+  var result = await locate(geolocation, storageAt(HOME, Date.now() - 2 * HOUR_MS));
+  assert.deepStrictEqual(result.coords, HOME);
+  assert.deepStrictEqual(geolocation.requests.map(function (options) {
+    return options.enableHighAccuracy;
+  }), [false, true]);
+});
+
+test('no fix at all is an error', async function () {
+  var result = await locate(createGeolocation(function () {
+    return null;
+  }), fakes.createStorage());
+  assert.strictEqual(result.err.message, 'timeout');
+});
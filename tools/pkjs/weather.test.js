@@ -0,0 +1,150 @@
+// src/pkjs/weather.js with both real providers behind a fake
+// XMLHttpRequest: failing over on 429, daily budgets and the cooldown
+// after repeated failures.
+var test = require('node:test');
+var assert = require('node:assert');
+var fakes = require('./fakes');
+var fetch = require('../../src/pkjs/fetch');
+var weather = require('../../src/pkjs/weather');
+var openWeatherMap = require('../../src/pkjs/providers/openweathermap');
+var darkSky = require('../../src/pkjs/providers/darksky');
+
+var OWM_URL = 'http://owm.test/';
+var DARKSKY_URL = 'http://darksky.test/';
+var COOLDOWN_MS = 30 * 60 * 1000;
+
+var owmBodies = {
+  weather: { main: { temp: 64 }, weather: [{ icon: '01d' }], dt: 1704067200 },
+  forecast: { list: [{ dt: 1704067200, main: { temp: 64 }, weather: [{ icon: '01d' }] },
+                     { dt: 1704078000, main: { temp: 60 }, weather: [{ icon: '01n' }] }] }
+};
+var darkSkyBody = { currently: { temperature: 50, icon: 'clear-day', time: 1704067200 },
+                    hourly: { data: [] } };
+
+// a backend over a fake network, owmStatus decides how openweathermap answers
+function createWorld(options) {
+  var world = { owmStatus: 200 };
+  var storage = fakes.createStorage();
+
+  world.XHR = fakes.createXHR(function (url) {
+    if (url.indexOf(OWM_URL) === 0) {
+      var kind = url.slice(OWM_URL.length).split('?')[0];
+      return world.owmStatus === 200 ? { status: 200, body: owmBodies[kind] } : { status: world.owmStatus, body: {} };
+    }
+    return { status: 200, body: darkSkyBody };
+  });
+  world.requests = function (baseUrl) {
+    return world.XHR.requests.filter(function (xhr) {
+      return xhr.url.indexOf(baseUrl) === 0;
+    }).length;
+  };
+
+  world.backend = weather.createBackend({
+    providers: [
+      openWeatherMap({ apiKey: 'k', baseUrl: OWM_URL, dailyBudget: options.owmBudget, forecastEntries: 2 }),
+      darkSky({ apiKey: 'k', baseUrl: DARKSKY_URL, dailyBudget: 500, forecastEntries: 2 })
+    ],
+    fetcher: fetch.createFetcher({ XMLHttpRequest: world.XHR, storage: storage, ttl: options.ttl || 0 }),
+    storage: storage,
+    errorThreshold: 2,
+    cooldownMs: COOLDOWN_MS
+  });
+  return world;
+}
+
+function getWeather(world, latitude) {
+  var pos = { coords: { latitude: latitude || 52.52, longitude: 13.4 } };
+  return new Promise(function (resolve) {
+    world.backend.getWeather(pos, function (err, reading, provider) {
+      resolve({ err: err, reading: reading, provider: provider });
+    });
+  });
+}
+
+test.beforeEach(function (t) {
+  t.mock.method(console, 'log', function () {});
+});
+
+test('429 moves on to the next provider and rests the first for the day', async function () {
+  var world = createWorld({ owmBudget: 500 });
+  world.owmStatus = 429;
+
+  var result = await getWeather(world);
+  assert.ifError(result.err);
+  assert.strictEqual(result.provider, 'darksky');
+  assert.strictEqual(result.reading.tempF, 50);
+  assert.strictEqual(world.requests(OWM_URL), 1);
+
+  // a single 429 is enough, no further requests until tomorrow
+  world.owmStatus = 200;
+  result = await getWeather(world);
+  assert.strictEqual(result.provider, 'darksky');
+  assert.strictEqual(world.requests(OWM_URL), 1);
+});
+
+test('exhausted budget skips the provider, cache hits do not count', async function () {
+  var world = createWorld({ owmBudget: 4, ttl: 60000 });
+
+  var result = await getWeather(world);
+  assert.strictEqual(result.provider, 'openweathermap');
+  assert.strictEqual(result.reading.forecast.entries.length, 2);
+  assert.strictEqual(world.requests(OWM_URL), 2);
+
+  // same position inside the ttl, answered from the cache
+  result = await getWeather(world);
+  assert.strictEqual(result.provider, 'openweathermap');
+  assert.strictEqual(result.reading.cached, true);
+  assert.strictEqual(world.requests(OWM_URL), 2);
+
+  // somewhere else takes two more network requests and uses up the 4
+  result = await getWeather(world, 48.85);
+  assert.strictEqual(result.provider, 'openweathermap');
+  assert.strictEqual(world.requests(OWM_URL), 4);
+  result = await getWeather(world, 40.71);
+  assert.strictEqual(result.provider, 'darksky');
+  assert.strictEqual(world.requests(OWM_URL), 4);
+});
+
+test('repeated failures rest the provider until the cooldown runs out', async function (t) {
+  var now = Date.now();
+  t.mock.method(Date, 'now', function () {
+    return now;
+  });
+  var world = createWorld({ owmBudget: 500 });
+  world.owmStatus = 500;
+
+  // one failure still leaves it first in line
+  var result = await getWeather(world);
+  assert.strictEqual(result.provider, 'darksky');
+  result = await getWeather(world);
+  assert.strictEqual(result.provider, 'darksky');
+  assert.strictEqual(world.requests(OWM_URL), 2);
+
+  // errorThreshold reached, skipped for the cooldown
+  world.owmStatus = 200;
+  now += COOLDOWN_MS - 1;
+  result = await getWeather(world);
+  assert.strictEqual(result.provider, 'darksky');
+  assert.strictEqual(world.requests(OWM_URL), 2);
+
+  now += 1;
+  result = await getWeather(world);
+  assert.strictEqual(result.provider, 'openweathermap');
+  assert.strictEqual(world.requests(OWM_URL), 4);
+});
+
+test('every provider out is an error', async function () {
+  var world = createWorld({ owmBudget: 1 });
+  world.XHR.prototype.send = function () {
+    var xhr = this;
+    setTimeout(function () {
+      xhr.status = 429;
+      xhr.onload();
+    }, 0);
+  };
+
+  var result = await getWeather(world);
+  assert.strictEqual(result.err.message, 'no weather provider available');
+  assert.strictEqual(world.requests(OWM_URL), 0);
+  assert.strictEqual(world.requests(DARKSKY_URL), 1);
+});